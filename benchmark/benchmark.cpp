@@ -0,0 +1,363 @@
+#include "benchmark.h"
+#include "mainwindow.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFile>
+#include <QThread>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QSysInfo>
+#include <QVideoFrame>
+#include <QVideoSurfaceFormat>
+#include <QAbstractVideoSurface>
+#include <algorithm>
+#include <cstring>
+
+MainWindow *Benchmark::createWindow(const QSize &size, const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    MainWindow::addOptions(parser);
+    QStringList args = {
+        "benchmark",
+        "-W", QString::number(size.width()),
+        "-H", QString::number(size.height()),
+        "--playlist", dir.filePath("empty.json"),
+        "--wordstore", dir.filePath("wordstore"),
+        "--wordlist", dir.filePath("wordlist.txt"),
+        "--media_cache", dir.filePath("media"),
+        "--image", dir.filePath("wordcloud.png"),
+        "--mask", dir.filePath("mask.png"),
+        "--no_image_output",
+        "--preroll", "0",
+    };
+    args.append(arguments);
+    parser.parse(args);
+    MainWindow *window = new MainWindow();
+    window->initParameters(parser);
+    window->show();
+    // Wait for the initial word cloud generation.
+    wait([window](){return window->scheduler->isIdle() && !window->image_watcher->isRunning();});
+    return window;
+}
+
+bool Benchmark::waitFor(const std::function<bool()> &condition, const int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (condition())
+        return true;
+    QEventLoop loop;
+    QTimer poll;
+    poll.setInterval(1);
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]()
+    {
+        if (condition() || timer.elapsed() > timeout)
+            loop.quit();
+    });
+    poll.start();
+    loop.exec();
+    return condition();
+}
+
+void Benchmark::wait(const std::function<bool()> &condition)
+{
+    if (waitFor(condition))
+        return;
+    qWarning() << "Benchmark timed out";
+    timed_out = true;
+}
+
+void Benchmark::report(const QString &name, const QJsonObject &parameters, QVector<double> samples, const QString &unit)
+{
+    QJsonObject result = {
+        {"name", name},
+        {"parameters", parameters},
+        {"unit", unit},
+        {"samples", samples.length()},
+        {"valid", !timed_out},
+    };
+    if (timed_out)
+        invalid++;
+    if (!samples.isEmpty())
+    {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (const double value : samples)
+            sum += value;
+        result["mean"] = sum / samples.length();
+        result["median"] = samples[samples.length()/2];
+        result["p95"] = samples[qMin(samples.length() - 1, int(0.95*samples.length()))];
+        result["min"] = samples.first();
+        result["max"] = samples.last();
+    }
+    results.append(result);
+    qInfo() << name << parameters << result["median"].toDouble() << unit << (timed_out ? "(invalid, timed out)" : "");
+}
+
+void Benchmark::wordcloudUpdate(const int entries)
+{
+    timed_out = false;
+    QFile::remove(dir.filePath("wordstore.snapshot"));
+    QFile::remove(dir.filePath("wordstore.journal"));
+    MainWindow *window = createWindow({1920, 1080});
+    QRandomGenerator rng(42);
+    for (int i=0; i<entries; i++)
+    {
+        // Words of letters only, such that they match the word filter.
+        QString word;
+        for (int n=i+1; n>0; n/=26)
+            word.append(QChar('a' + n % 26));
+        window->wordstore->add("w" + word, rng.bounded(1, 101));
+    }
+    QVector<double> incremental, full;
+    for (int i=0; i<repeat; i++)
+    {
+        QElapsedTimer timer;
+        window->lineedit->setText("benchmark" + QString(QChar('a' + i % 26)));
+        timer.start();
+        window->updateWordcloud();
+        wait([window](){return window->scheduler->isIdle();});
+        incremental.append(timer.nsecsElapsed() / 1e6);
+
+        timer.start();
+        window->relayoutWordcloud();
+        wait([window](){return window->scheduler->isIdle();});
+        full.append(timer.nsecsElapsed() / 1e6);
+    }
+    report("wordcloud_update", {{"entries", entries}, {"layout", "incremental"}}, incremental);
+    report("wordcloud_update", {{"entries", entries}, {"layout", "full"}}, full);
+    delete window;
+}
+
+void Benchmark::pixmapDecode()
+{
+    timed_out = false;
+    MainWindow *window = createWindow({1920, 1080});
+    const QString path = dir.filePath("decode.png");
+    window->engine.generate(window->wordstore->frequencies()).save(path);
+    window->pixmap_path = path;
+
+    QVector<double> decode, update;
+    for (int i=0; i<repeat; i++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        QImage image(path);
+        decode.append(timer.nsecsElapsed() / 1e6);
+
+        bool done = false;
+        const QMetaObject::Connection connection = QObject::connect(window->image_watcher, &QFutureWatcher<QImage>::finished, [&done](){done = true;});
+        timer.start();
+        window->loadPixmap();
+        wait([&done](){return done;});
+        update.append(timer.nsecsElapsed() / 1e6);
+        QObject::disconnect(connection);
+    }
+    report("png_decode", {{"width", 1920}, {"height", 1080}}, decode);
+    report("update_pixmap", {{"width", 1920}, {"height", 1080}}, update);
+    delete window;
+}
+
+void Benchmark::imageChangeAnimation(const QSize &size)
+{
+    timed_out = false;
+    MainWindow *window = createWindow(size);
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    QVector<double> intervals;
+    QElapsedTimer frame;
+    const QMetaObject::Connection connection = QObject::connect(window->pic_change_anim, &QVariantAnimation::valueChanged, [&]()
+    {
+        if (frame.isValid())
+            intervals.append(frame.nsecsElapsed() / 1e6);
+        frame.start();
+    });
+    for (int i=0; i<repeat; i++)
+    {
+        image.fill(i % 2 ? Qt::darkGreen : Qt::black);
+        frame.invalidate();
+        window->showPixmap(QPixmap::fromImage(image));
+        wait([window](){return window->pic_change_anim->state() == QAbstractAnimation::Stopped;});
+    }
+    QObject::disconnect(connection);
+    report("image_change_frame_interval", {{"width", size.width()}, {"height", size.height()}}, intervals);
+    delete window;
+}
+
+void Benchmark::videoFade(const QSize &size)
+{
+    timed_out = false;
+    MainWindow *window = createWindow(size);
+    // Grey frame as decoded by the media backend, the item converts it on
+    // every repaint while its opacity changes.
+    QVideoFrame video(size.width() * size.height() * 3 / 2, size, size.width(), QVideoFrame::Format_YUV420P);
+    video.map(QAbstractVideoBuffer::WriteOnly);
+    memset(video.bits(), 128, size_t(video.mappedBytes()));
+    video.unmap();
+
+    QVector<double> intervals;
+    QElapsedTimer frame;
+    const QMetaObject::Connection connection = QObject::connect(window->video_anim, &QVariantAnimation::valueChanged, [&]()
+    {
+        if (frame.isValid())
+            intervals.append(frame.nsecsElapsed() / 1e6);
+        frame.start();
+    });
+    const auto stopped = [window](){return window->anim_group->state() == QAbstractAnimation::Stopped;};
+    for (int i=0; i<repeat; i++)
+    {
+        // Releasing the player after the fade out stops the surface.
+        QAbstractVideoSurface *surface = window->videoitem->videoSurface();
+        if (!surface->isActive())
+            surface->start(QVideoSurfaceFormat(size, QVideoFrame::Format_YUV420P));
+        surface->present(video);
+        frame.invalidate();
+        window->play();
+        wait(stopped);
+        // Without media there is no duration to schedule the fade out.
+        window->video_timer->stop();
+        frame.invalidate();
+        window->fadeOut();
+        wait(stopped);
+    }
+    QObject::disconnect(connection);
+    report("video_fade_frame_interval", {{"width", size.width()}, {"height", size.height()}}, intervals);
+    delete window;
+}
+
+void Benchmark::wordFilter(const int terms)
+{
+    QRandomGenerator rng(42);
+    const auto randomWord = [&rng]()
+    {
+        QString word;
+        const int length = rng.bounded(3, 12);
+        for (int i=0; i<length; i++)
+            word.append(QChar('a' + rng.bounded(26)));
+        return word;
+    };
+    for (const QString name : {"stopwords.txt", "blocklist.txt"})
+    {
+        QFile file(dir.filePath(name));
+        file.open(QFile::WriteOnly);
+        for (int i=0; i<terms; i++)
+            file.write(randomWord().toUtf8() + "\n");
+    }
+    WordFilter filter;
+    filter.loadStopwords(dir.filePath("stopwords.txt"));
+    filter.loadBlocklist(dir.filePath("blocklist.txt"));
+    QStringList words;
+    for (int i=0; i<100000; i++)
+        words.append(randomWord());
+
+    QVector<double> samples;
+    for (int i=0; i<repeat; i++)
+    {
+        int accepted = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (const QString &word : words)
+            accepted += filter.check(word) == WordFilter::Accepted;
+        samples.append(words.length() / (timer.nsecsElapsed() / 1e9));
+        Q_UNUSED(accepted);
+    }
+    report("word_filter", {{"terms", terms}}, samples, "words/s");
+}
+
+void Benchmark::loadPlaylist(const int entries)
+{
+    timed_out = false;
+    const QString path = dir.filePath("playlist.json");
+    {
+        QJsonObject playlist;
+        for (int i=0; i<entries; i++)
+            playlist.insert(QString("video %1").arg(i, 6, 10, QChar('0')), dir.filePath(QString("video_%1.mp4").arg(i)));
+        QFile file(path);
+        file.open(QFile::WriteOnly);
+        file.write(QJsonDocument(playlist).toJson());
+    }
+    QVector<double> samples;
+    for (int i=0; i<repeat; i++)
+    {
+        MainWindow *window = createWindow({1280, 720});
+        QElapsedTimer timer;
+        timer.start();
+        window->playlist->load(path);
+        samples.append(timer.nsecsElapsed() / 1e6);
+        delete window;
+    }
+    report("load_playlist", {{"entries", entries}}, samples);
+}
+
+QJsonObject Benchmark::result() const
+{
+    return {
+        {"qt_version", qVersion()},
+        {"platform", QGuiApplication::platformName()},
+        {"cpu", QSysInfo::currentCpuArchitecture()},
+        {"ideal_thread_count", QThread::idealThreadCount()},
+        {"timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {"results", results},
+    };
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Run without display unless a platform is requested explicitly.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless benchmarks of VideoSwitch, results are written as JSON.");
+    parser.addOptions({
+                          {"output", "write results to this file instead of stdout", "file"},
+                          {"repeat", "number of repetitions of each measurement (default: 5)", "int"},
+                      });
+    parser.addHelpOption();
+    parser.process(app);
+
+    int repeat = 5;
+    if (!parser.value("repeat").isEmpty())
+        repeat = qMax(1, parser.value("repeat").toInt());
+    Benchmark benchmark(repeat);
+    for (const int entries : {1000, 10000, 100000})
+        benchmark.wordcloudUpdate(entries);
+    benchmark.pixmapDecode();
+    for (const QSize &size : {QSize(1280, 720), QSize(1920, 1080), QSize(3840, 2160)})
+    {
+        benchmark.imageChangeAnimation(size);
+        benchmark.videoFade(size);
+    }
+    for (const int terms : {100, 10000})
+        benchmark.wordFilter(terms);
+    for (const int entries : {100, 1000, 10000})
+        benchmark.loadPlaylist(entries);
+
+    const QByteArray json = QJsonDocument(benchmark.result()).toJson();
+    if (parser.value("output").isEmpty())
+    {
+        QFile out;
+        out.open(stdout, QFile::WriteOnly);
+        out.write(json);
+    }
+    else
+    {
+        QFile out(parser.value("output"));
+        if (!out.open(QFile::WriteOnly))
+        {
+            qCritical() << "Could not write" << parser.value("output");
+            return 1;
+        }
+        out.write(json);
+    }
+    if (benchmark.failed())
+    {
+        qCritical() << "Some measurements timed out, their results are invalid";
+        return 1;
+    }
+    return 0;
+}
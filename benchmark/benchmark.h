@@ -0,0 +1,67 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QStringList>
+#include <QVector>
+#include <QSize>
+#include <functional>
+
+class MainWindow;
+
+
+/// Headless benchmarks driving MainWindow directly. Results are collected
+/// as JSON objects.
+class Benchmark
+{
+    /// Collected results.
+    QJsonArray results;
+    /// Directory for word store, playlists and images.
+    QTemporaryDir dir;
+    /// Number of repetitions of each measurement.
+    int repeat = 5;
+    /// A wait of the current measurement timed out, its results are marked
+    /// invalid.
+    bool timed_out = false;
+    /// Number of invalid results.
+    int invalid = 0;
+
+    /// Create and initialize a MainWindow with the given command line
+    /// arguments in addition to defaults suitable for benchmarks.
+    MainWindow *createWindow(const QSize &size, const QStringList &arguments = {});
+    /// Run the event loop until condition is true. Returns false on timeout.
+    static bool waitFor(const std::function<bool()> &condition, const int timeout = 60000);
+    /// Same as waitFor(), but a timeout marks the current measurement as
+    /// invalid.
+    void wait(const std::function<bool()> &condition);
+    /// Add result with statistics of samples. The result is marked invalid
+    /// if a wait of the current measurement timed out.
+    void report(const QString &name, const QJsonObject &parameters, QVector<double> samples, const QString &unit = "ms");
+
+public:
+    Benchmark(const int repeat) : repeat(repeat) {}
+    /// Latency of a word cloud update for a word store with the given
+    /// number of entries.
+    void wordcloudUpdate(const int entries);
+    /// Decoding of the word cloud image in updatePixmap.
+    void pixmapDecode();
+    /// Frame times of the image change animation (crossfade between word
+    /// clouds).
+    void imageChangeAnimation(const QSize &size);
+    /// Frame times of the video fading in over the word cloud and out again
+    /// (anim_group), with a YUV video frame.
+    void videoFade(const QSize &size);
+    /// Throughput of the word filter with blocklist and stopwords of the
+    /// given size.
+    void wordFilter(const int terms);
+    /// Loading a playlist with the given number of entries.
+    void loadPlaylist(const int entries);
+    /// All results as JSON.
+    QJsonObject result() const;
+    /// Some results are invalid.
+    bool failed() const {return invalid > 0;}
+};
+
+#endif // BENCHMARK_H
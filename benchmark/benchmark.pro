@@ -0,0 +1,14 @@
+QT       += core gui multimedia multimediawidgets concurrent network svg
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = benchmark
+
+SOURCES += benchmark.cpp
+
+HEADERS += benchmark.h
+
+include(../videoswitch.pri)
@@ -0,0 +1,158 @@
+#include "cloudcache.h"
+#include <QtConcurrent>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDebug>
+
+CloudCache::CloudCache(QObject *parent) :
+    QObject(parent)
+{
+}
+
+CloudCache::~CloudCache()
+{
+    // The jobs notify this object, they must not outlive it. Their files
+    // are not in disk yet.
+    for (QFuture<void> &write : writes)
+        write.waitForFinished();
+    for (const QByteArray &key : spilling)
+        QFile::remove(filePath(key));
+    for (auto it = disk.constBegin(); it != disk.constEnd(); ++it)
+        QFile::remove(filePath(it.key()));
+}
+
+QString CloudCache::filePath(const QByteArray &key) const
+{
+    return QDir(cache_dir).filePath(QString::fromLatin1(key) + ".raw");
+}
+
+void CloudCache::insert(const QByteArray &key, const QImage &image)
+{
+    if (key.isEmpty() || image.isNull())
+        return;
+    Entry &entry = memory[key];
+    if (entry.image.isNull())
+        memory_used += image.sizeInBytes();
+    entry.image = image;
+    entry.last_used = ++use_counter;
+    evict();
+}
+
+QImage CloudCache::find(const QByteArray &key)
+{
+    auto it = memory.find(key);
+    if (it == memory.end())
+        return QImage();
+    it->last_used = ++use_counter;
+    return it->image;
+}
+
+std::function<QImage()> CloudCache::loader(const QByteArray &key)
+{
+    auto it = disk.find(key);
+    if (it == disk.end())
+        return nullptr;
+    it->second = ++use_counter;
+    const QString path = filePath(key);
+    return [path](){return readRaw(path);};
+}
+
+void CloudCache::evict()
+{
+    qint64 pending = 0;
+    for (const QByteArray &key : spilling)
+        pending += memory.value(key).image.sizeInBytes();
+    while (memory_used - pending > memory_budget)
+    {
+        QByteArray oldest;
+        quint64 oldest_use = 0;
+        for (auto it = memory.constBegin(); it != memory.constEnd(); ++it)
+            if (!spilling.contains(it.key()) && (oldest.isEmpty() || it->last_used < oldest_use))
+            {
+                oldest = it.key();
+                oldest_use = it->last_used;
+            }
+        if (oldest.isEmpty())
+            break;
+        const QImage image = memory.value(oldest).image;
+        if (!QDir().mkpath(cache_dir))
+        {
+            qWarning() << "Could not create cache directory" << cache_dir;
+            memory_used -= image.sizeInBytes();
+            memory.remove(oldest);
+            continue;
+        }
+        // The image stays in memory until it is written.
+        spilling.insert(oldest);
+        pending += image.sizeInBytes();
+        const QString path = filePath(oldest);
+        for (auto it = writes.begin(); it != writes.end();)
+            it = it->isFinished() ? writes.erase(it) : it + 1;
+        writes.append(QtConcurrent::run([this, oldest, image, path]()
+        {
+            const qint64 bytes = writeRaw(path, image) ? image.sizeInBytes() : -1;
+            QMetaObject::invokeMethod(this, [this, oldest, bytes](){spilled(oldest, bytes);}, Qt::QueuedConnection);
+        }));
+    }
+    while (disk_used > disk_budget && !disk.isEmpty())
+    {
+        auto oldest = disk.begin();
+        for (auto it = disk.begin(); it != disk.end(); ++it)
+            if (it->second < oldest->second)
+                oldest = it;
+        QFile::remove(filePath(oldest.key()));
+        disk_used -= oldest->first;
+        disk.erase(oldest);
+    }
+}
+
+void CloudCache::spilled(const QByteArray &key, const qint64 bytes)
+{
+    spilling.remove(key);
+    const auto it = memory.find(key);
+    if (it != memory.end())
+    {
+        memory_used -= it->image.sizeInBytes();
+        if (bytes >= 0)
+            disk.insert(key, {bytes, it->last_used});
+        memory.erase(it);
+    }
+    if (bytes < 0)
+        qWarning() << "Could not write word cloud to cache directory" << cache_dir;
+    else
+        disk_used += bytes;
+    evict();
+}
+
+bool CloudCache::writeRaw(const QString &path, const QImage &image)
+{
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly))
+        return false;
+    QDataStream stream(&file);
+    stream << quint32(0x56534343) << qint32(image.width()) << qint32(image.height())
+           << qint32(image.format()) << qint32(image.bytesPerLine());
+    stream.writeRawData(reinterpret_cast<const char*>(image.constBits()), int(image.sizeInBytes()));
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+QImage CloudCache::readRaw(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return QImage();
+    QDataStream stream(&file);
+    quint32 magic;
+    qint32 width, height, format, stride;
+    stream >> magic >> width >> height >> format >> stride;
+    if (stream.status() != QDataStream::Ok || magic != 0x56534343 || width <= 0 || height <= 0)
+        return QImage();
+    QImage image(width, height, QImage::Format(format));
+    if (image.isNull() || image.bytesPerLine() != stride)
+        return QImage();
+    if (stream.readRawData(reinterpret_cast<char*>(image.bits()), int(image.sizeInBytes())) != image.sizeInBytes())
+        return QImage();
+    return image;
+}
@@ -0,0 +1,77 @@
+#ifndef CLOUDCACHE_H
+#define CLOUDCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include <QByteArray>
+#include <QFuture>
+#include <functional>
+
+
+/// Bounded LRU cache of rendered word clouds, keyed by content hash (see
+/// MainWindow::contentHash()). Images are kept in memory up to a budget and
+/// spill to raw files in a directory when they are evicted from memory.
+/// The disk cache is bounded as well and only lives as long as the program.
+class CloudCache : public QObject
+{
+    Q_OBJECT
+
+    struct Entry
+    {
+        QImage image;
+        /// Value of use_counter at last use, for LRU eviction.
+        quint64 last_used = 0;
+    };
+
+    /// Images in memory.
+    QHash<QByteArray, Entry> memory;
+    /// Images in memory which are being written to disk.
+    QSet<QByteArray> spilling;
+    /// Running write jobs, which reference this cache.
+    QList<QFuture<void>> writes;
+    /// Images on disk, by key: size in bytes and last use.
+    QHash<QByteArray, QPair<qint64, quint64>> disk;
+    /// Directory for spilled images.
+    QString cache_dir = "/tmp/videoswitch-clouds";
+    qint64 memory_budget = 256*1024*1024;
+    qint64 disk_budget = 2048LL*1024*1024;
+    qint64 memory_used = 0;
+    qint64 disk_used = 0;
+    /// Counter for LRU order.
+    quint64 use_counter = 0;
+
+    QString filePath(const QByteArray &key) const;
+    /// Move least recently used images to disk until the memory budget is
+    /// met, and delete files until the disk budget is met.
+    void evict();
+    /// Write raw image to path (in a worker thread).
+    static bool writeRaw(const QString &path, const QImage &image);
+
+private slots:
+    /// Spilled image was written to disk.
+    void spilled(const QByteArray &key, const qint64 bytes);
+
+public:
+    CloudCache(QObject *parent = nullptr);
+    /// Waits for running writes and deletes all spilled images.
+    ~CloudCache();
+    void setDirectory(const QString &path) {cache_dir = path;}
+    void setMemoryBudget(const qint64 bytes) {memory_budget = bytes; evict();}
+    void setDiskBudget(const qint64 bytes) {disk_budget = bytes; evict();}
+
+    /// Store image under key.
+    void insert(const QByteArray &key, const QImage &image);
+    /// Image is in memory or on disk.
+    bool contains(const QByteArray &key) const {return memory.contains(key) || disk.contains(key);}
+    /// Image from memory, null if it is not in memory.
+    QImage find(const QByteArray &key);
+    /// Function loading a spilled image, which may be called in any thread.
+    /// Returns null function if the image is not on disk.
+    std::function<QImage()> loader(const QByteArray &key);
+    /// Read raw image from path.
+    static QImage readRaw(const QString &path);
+};
+
+#endif // CLOUDCACHE_H
@@ -0,0 +1,190 @@
+#include "crossfadeitem.h"
+#include <QPainter>
+#include <QElapsedTimer>
+#include <cstring>
+#include "metrics.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define CROSSFADE_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/// Blend count premultiplied pixels: out = (a*(256-weight) + b*weight) / 256
+/// for each channel. The weights add up to 256, so the sums fit in 16 bit.
+typedef void (*LerpRow)(const quint32 *a, const quint32 *b, quint32 *out, const int count, const int weight);
+
+void lerpRowScalar(const quint32 *a, const quint32 *b, quint32 *out, const int count, const int weight)
+{
+    const quint32 inverse = 256 - weight;
+    for (int i=0; i<count; i++)
+    {
+        // Two channels at once in the low bytes of each 16 bit half.
+        const quint32 lo = (((a[i] & 0x00ff00ff) * inverse + (b[i] & 0x00ff00ff) * weight) >> 8) & 0x00ff00ff;
+        const quint32 hi = (((a[i] >> 8) & 0x00ff00ff) * inverse + ((b[i] >> 8) & 0x00ff00ff) * weight) & 0xff00ff00;
+        out[i] = hi | lo;
+    }
+}
+
+#ifdef CROSSFADE_X86
+
+void lerpRowSse2(const quint32 *a, const quint32 *b, quint32 *out, const int count, const int weight)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(256 - weight);
+    const __m128i wb = _mm_set1_epi16(weight);
+    int i = 0;
+    for (; i+4<=count; i+=4)
+    {
+        const __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        const __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), wa),
+                                                        _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), wb)), 8);
+        const __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), wa),
+                                                        _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), wb)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(lo, hi));
+    }
+    lerpRowScalar(a + i, b + i, out + i, count - i, weight);
+}
+
+__attribute__((target("avx2")))
+void lerpRowAvx2(const quint32 *a, const quint32 *b, quint32 *out, const int count, const int weight)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wa = _mm256_set1_epi16(256 - weight);
+    const __m256i wb = _mm256_set1_epi16(weight);
+    int i = 0;
+    for (; i+8<=count; i+=8)
+    {
+        // Unpack and pack work within 128 bit lanes, so the order is kept.
+        const __m256i pa = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i pb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        const __m256i lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(pa, zero), wa),
+                                                              _mm256_mullo_epi16(_mm256_unpacklo_epi8(pb, zero), wb)), 8);
+        const __m256i hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(pa, zero), wa),
+                                                              _mm256_mullo_epi16(_mm256_unpackhi_epi8(pb, zero), wb)), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packus_epi16(lo, hi));
+    }
+    lerpRowSse2(a + i, b + i, out + i, count - i, weight);
+}
+
+#endif // CROSSFADE_X86
+
+LerpRow lerpRow()
+{
+#ifdef CROSSFADE_X86
+    static const LerpRow kernel = __builtin_cpu_supports("avx2") ? lerpRowAvx2 : lerpRowSse2;
+    return kernel;
+#else
+    return lerpRowScalar;
+#endif
+}
+
+}
+
+
+CrossfadeItem::CrossfadeItem(QGraphicsItem *parent) :
+    QGraphicsObject(parent)
+{
+    hide();
+}
+
+QRect CrossfadeItem::differingRect(const QImage &a, const QImage &b)
+{
+    const int width = a.width();
+    const size_t row_bytes = size_t(width) * 4;
+    int top = 0;
+    while (top < a.height() && std::memcmp(a.constScanLine(top), b.constScanLine(top), row_bytes) == 0)
+        top++;
+    if (top == a.height())
+        return QRect();
+    int bottom = a.height() - 1;
+    while (bottom > top && std::memcmp(a.constScanLine(bottom), b.constScanLine(bottom), row_bytes) == 0)
+        bottom--;
+    // Columns only need to be searched outside of the range found so far.
+    int left = width;
+    int right = -1;
+    for (int y=top; y<=bottom; y++)
+    {
+        const quint32 *row_a = reinterpret_cast<const quint32*>(a.constScanLine(y));
+        const quint32 *row_b = reinterpret_cast<const quint32*>(b.constScanLine(y));
+        for (int x=0; x<left; x++)
+            if (row_a[x] != row_b[x])
+            {
+                left = x;
+                break;
+            }
+        for (int x=width-1; x>right; x--)
+            if (row_a[x] != row_b[x])
+            {
+                right = x;
+                break;
+            }
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+bool CrossfadeItem::start(const QImage &old_image, const QImage &new_image)
+{
+    if (old_image.isNull() || new_image.isNull() || old_image.size() != new_image.size())
+    {
+        clear();
+        return false;
+    }
+    // Opaque images stay in RGB32, which is drawn without blending.
+    const QImage::Format format = old_image.hasAlphaChannel() || new_image.hasAlphaChannel()
+            ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    prepareGeometryChange();
+    from = old_image.convertToFormat(format);
+    to = new_image.convertToFormat(format);
+    dirty = differingRect(from, to);
+    if (buffer.size() != dirty.size() || buffer.format() != format)
+        buffer = QImage(dirty.size(), format);
+    position = 0;
+    buffer_weight = -1;
+    show();
+    update();
+    return true;
+}
+
+void CrossfadeItem::clear()
+{
+    prepareGeometryChange();
+    hide();
+    from = QImage();
+    to = QImage();
+    buffer = QImage();
+    dirty = QRect();
+    buffer_weight = -1;
+}
+
+void CrossfadeItem::setProgress(const qreal value)
+{
+    position = value;
+    if (qRound(256 * position) != buffer_weight)
+        update();
+}
+
+void CrossfadeItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(option)
+    Q_UNUSED(widget)
+    if (dirty.isEmpty())
+        return;
+    const int weight = qBound(0, qRound(256 * position), 256);
+    if (weight != buffer_weight)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        const LerpRow lerp = lerpRow();
+        for (int y=0; y<dirty.height(); y++)
+            lerp(reinterpret_cast<const quint32*>(from.constScanLine(dirty.top() + y)) + dirty.left(),
+                 reinterpret_cast<const quint32*>(to.constScanLine(dirty.top() + y)) + dirty.left(),
+                 reinterpret_cast<quint32*>(buffer.scanLine(y)), dirty.width(), weight);
+        buffer_weight = weight;
+        Metrics::instance().observe("crossfade_blend_ms", timer.nsecsElapsed() / 1e6);
+    }
+    painter->drawImage(dirty.topLeft(), buffer);
+}
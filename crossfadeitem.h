@@ -0,0 +1,50 @@
+#ifndef CROSSFADEITEM_H
+#define CROSSFADEITEM_H
+
+#include <QGraphicsObject>
+#include <QImage>
+
+
+/// Transition between two word cloud images of the same size. The item lies
+/// on top of the item showing the new image and only covers the region in
+/// which old and new image differ. Each animation step blends this region
+/// once with a SIMD kernel into a reused buffer, which is then drawn without
+/// further alpha blending. Only this region is repainted during the
+/// transition.
+class CrossfadeItem : public QGraphicsObject
+{
+    Q_OBJECT
+    Q_PROPERTY(qreal progress READ progress WRITE setProgress)
+
+    /// Old image, shown at progress 0.
+    QImage from;
+    /// New image, shown at progress 1.
+    QImage to;
+    /// Region in which from and to differ.
+    QRect dirty;
+    /// Blended dirty region.
+    QImage buffer;
+    /// Progress from 0 (old image) to 1 (new image).
+    qreal position = 0;
+    /// Weight (0 to 256) of the new image in buffer, -1 if not blended yet.
+    int buffer_weight = -1;
+
+    /// Bounding rectangle of all pixels which differ between a and b.
+    static QRect differingRect(const QImage &a, const QImage &b);
+
+public:
+    CrossfadeItem(QGraphicsItem *parent = nullptr);
+    /// Start transition from old_image to new_image at progress 0 and show
+    /// the item. Returns false if the images cannot be blended (different
+    /// sizes or null images).
+    bool start(const QImage &old_image, const QImage &new_image);
+    /// Hide the item and release images and buffer.
+    void clear();
+    qreal progress() const {return position;}
+    void setProgress(const qreal value);
+
+    QRectF boundingRect() const override {return QRectF(dirty);}
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+};
+
+#endif // CROSSFADEITEM_H
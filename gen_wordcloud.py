@@ -1,8 +1,14 @@
 #!/bin/env python3
 '''
 Generate a word cloud of /tmp/wordlist.txt in /tmp/wordcloud.png.
+Instead of a text file, a file of word frequencies (lines "word<TAB>weight")
+can be given as source. The image can also be written as raw pixels to a
+shared memory file.
 '''
 
+import os
+import mmap
+import struct
 from PIL import Image
 import numpy as np
 from wordcloud import WordCloud
@@ -17,16 +23,63 @@ cm_b = lambda x: 0.5 * (x > 0.5) * (x - 0.5)
 cm = LinearSegmentedColormap('gauss', {'red':cm_r, 'green':cm_g, 'blue':cm_b}, 256, gamma=1)
 
 
-def exportWordcloud(
-            textfile : "input"  = "/tmp/wordlist.txt",
-            maskfile : "mask"   = "mask.png",
-            outfile  : "output" = "/tmp/wordcloud.png",
-        ):
-    text = open(textfile, encoding="utf-8").read()
+class SharedImage:
+    '''
+    Double buffered raw image in a shared memory file (e.g. in /dev/shm),
+    which videoswitch reads without PNG encoding and decoding.
+    The header contains magic b"VSWC", version, width, height, bytes per line,
+    a reserved field and the generation counter. The image of generation n
+    is stored as premultiplied ARGB32 (BGRA bytes) in buffer n % 2.
+    '''
+    header = struct.Struct("<4sIIIIIQ")
+    header_size = 64
+
+    def __init__(self, path, width, height):
+        self.width = width
+        self.height = height
+        self.stride = 4 * width
+        size = self.header_size + 2 * self.stride * height
+        fd = os.open(path, os.O_RDWR | os.O_CREAT, 0o644)
+        try:
+            if os.fstat(fd).st_size != size:
+                os.ftruncate(fd, size)
+            self.map = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        magic, _, w, h, _, _, generation = self.header.unpack_from(self.map, 0)
+        self.generation = generation if (magic, w, h) == (b"VSWC", width, height) else 0
+
+    def write(self, rgb):
+        generation = self.generation + 1
+        offset = self.header_size + (generation % 2) * self.stride * self.height
+        buffer = np.ndarray((self.height, self.width, 4), dtype=np.uint8, buffer=self.map, offset=offset)
+        buffer[..., 0] = rgb[..., 2]
+        buffer[..., 1] = rgb[..., 1]
+        buffer[..., 2] = rgb[..., 0]
+        buffer[..., 3] = 255
+        self.header.pack_into(self.map, 0, b"VSWC", 1, self.width, self.height, self.stride, 0, generation)
+        self.generation = generation
+        return generation
+
+
+def writeWordcloud(wc, outfile, shared):
+    '''
+    Write word cloud to image file and/or shared memory. Return a
+    description of the result (generation number or file name).
+    '''
+    result = outfile
+    if shared is not None:
+        result = shared.write(wc.to_array())
+    if outfile:
+        wc.to_file(outfile)
+    return result
+
+
+def createWordcloud(maskfile = "mask.png"):
     color = np.array(Image.open(maskfile))
     mask = 255 * (color[...,0] * color[...,1] * color[...,2] == 0)
     #image_colors = ImageColorGenerator(color)
-    wc = WordCloud(
+    return WordCloud(
             max_font_size = 250,
             #font_path = "/usr/share/fonts/titillium/Titillium-Regular.otf",
             mask = mask,
@@ -38,15 +91,77 @@ def exportWordcloud(
             #color_func = image_colors,
             colormap = cm,
         )
-    wc.generate(text)
-    wc.to_file(outfile)
+
+
+def readFrequencies(freqfile):
+    frequencies = {}
+    for line in open(freqfile, encoding="utf-8"):
+        word, _, weight = line.rstrip("\n").rpartition("\t")
+        try:
+            frequencies[word] = frequencies.get(word, 0.) + float(weight)
+        except ValueError:
+            pass
+    return frequencies
+
+
+def generateWordcloud(wc, textfile, freqfile):
+    if freqfile:
+        wc.generate_from_frequencies(readFrequencies(freqfile))
+    else:
+        wc.generate(open(textfile, encoding="utf-8").read())
+
+
+def exportWordcloud(
+            textfile : "input"  = "/tmp/wordlist.txt",
+            maskfile : "mask"   = "mask.png",
+            outfile  : "output" = "/tmp/wordcloud.png",
+            freqfile : "frequencies" = "",
+            shmfile  : "shm" = "",
+            daemon   : "daemon" = "0",
+        ):
+    wc = createWordcloud(maskfile)
+    shared = SharedImage(shmfile, wc.mask.shape[1], wc.mask.shape[0]) if shmfile else None
+    if daemon not in ("0", "", "false", "no"):
+        serveWordcloud(wc, textfile, freqfile, outfile, shared)
+        return
+    generateWordcloud(wc, textfile, freqfile)
+    writeWordcloud(wc, outfile, shared)
+
+
+def serveWordcloud(wc, textfile, freqfile, outfile, shared):
+    '''
+    Keep running and regenerate the word cloud for each command
+    "regenerate <seq>" read from stdin. After writing the image, reply
+    "done <seq> <generation>" if shared memory is used or "done <seq> <outfile>"
+    (or "error <seq> <message>") on stdout.
+    Stop on "quit" or end of input.
+    '''
+    from sys import stdin
+    for line in stdin:
+        command = line.split()
+        if not command:
+            continue
+        if command[0] == "quit":
+            break
+        seq = command[1] if len(command) > 1 else "0"
+        if command[0] != "regenerate":
+            print("error", seq, "unknown command", command[0], flush=True)
+            continue
+        try:
+            generateWordcloud(wc, textfile, freqfile)
+            print("done", seq, writeWordcloud(wc, outfile, shared), flush=True)
+        except Exception as e:
+            print("error", seq, str(e).replace("\n", " "), flush=True)
 
 
 def print_help():
     print('''Usage: python gen_wordcloud.py [key=value ...]\nAvailable options:
     input  : text file containing words to generate word cloud
+    frequencies : file of word frequencies (word<TAB>weight), used instead of input
     mask   : image file to generate mask for word cloud
-    output : file name of output image''')
+    output : file name of output image (may be empty if shm is given)
+    shm    : shared memory file for raw output image (e.g. /dev/shm/videoswitch-wordcloud)
+    daemon : if 1, keep running and regenerate on "regenerate <seq>" from stdin''')
 
 
 if __name__ == '__main__':
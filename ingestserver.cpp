@@ -0,0 +1,227 @@
+#include "ingestserver.h"
+#include <QJsonDocument>
+#include <QtMath>
+#include <QDebug>
+
+IngestServer::IngestServer(QObject *parent) :
+    QObject(parent),
+    server(new QTcpServer(this)),
+    flush_timer(new QTimer(this))
+{
+    qRegisterMetaType<QVector<WordFrequency>>("QVector<WordFrequency>");
+    flush_timer->setSingleShot(true);
+    flush_timer->setInterval(250);
+    connect(flush_timer, &QTimer::timeout, this, &IngestServer::flush);
+    connect(server, &QTcpServer::newConnection, this, &IngestServer::newConnection);
+}
+
+bool IngestServer::listen(const quint16 port)
+{
+    if (!server->listen(QHostAddress::LocalHost, port))
+    {
+        qWarning() << "Could not start word submission server:" << server->errorString();
+        return false;
+    }
+    qInfo() << "accepting word submissions on http://localhost:" + QString::number(port) + "/words";
+    return true;
+}
+
+void IngestServer::newConnection()
+{
+    while (server->hasPendingConnections())
+    {
+        QTcpSocket *socket = server->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, &IngestServer::readRequest);
+    }
+}
+
+void IngestServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (socket == nullptr)
+        return;
+    // Wait until header and body are complete.
+    const QByteArray data = socket->peek(socket->bytesAvailable());
+    const int header_end = data.indexOf("\r\n\r\n");
+    if (header_end < 0)
+    {
+        if (data.length() > 65536)
+            respond(socket, "431 Request Header Fields Too Large", {{"error", "header too large"}});
+        return;
+    }
+    const QList<QByteArray> lines = data.left(header_end).split('\n');
+    const QList<QByteArray> request = lines.first().trimmed().split(' ');
+    int content_length = 0;
+    bool json = false;
+    for (const QByteArray &line : lines)
+    {
+        const QByteArray lower = line.trimmed().toLower();
+        if (lower.startsWith("content-length:"))
+            content_length = lower.mid(15).trimmed().toInt();
+        else if (lower.startsWith("content-type:"))
+            json = lower.contains("json");
+    }
+    if (content_length > 16*1024*1024)
+    {
+        respond(socket, "413 Payload Too Large", {{"error", "request too large"}});
+        return;
+    }
+    if (data.length() < header_end + 4 + content_length)
+        return;
+    socket->read(header_end + 4);
+    const QByteArray body = socket->read(content_length);
+    if (request.length() < 2)
+    {
+        respond(socket, "400 Bad Request", {{"error", "invalid request"}});
+        return;
+    }
+    handleRequest(socket, request[0], request[1], body, json);
+}
+
+void IngestServer::handleRequest(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &body, const bool json)
+{
+    if (method == "GET" && path == "/status")
+    {
+        respond(socket, "200 OK", {{"pending", unapplied.loadAcquire()}, {"max_pending", max_pending}, {"rate", rate}});
+        return;
+    }
+    if (method != "POST" || path != "/words")
+    {
+        respond(socket, "404 Not Found", {{"error", "use POST /words or GET /status"}});
+        return;
+    }
+    const QVector<WordFrequency> words = parseWords(body, json);
+    if (words.length() > max_pending)
+    {
+        respond(socket, "413 Payload Too Large", {{"error", "batch too large"}, {"max_batch", max_pending}});
+        return;
+    }
+    if (unapplied.loadAcquire() + words.length() > max_pending)
+    {
+        respond(socket, "503 Service Unavailable", {{"error", "too many pending words"}, {"pending", unapplied.loadAcquire()}}, 1);
+        return;
+    }
+    if (rate > 0 && words.length() > burst)
+    {
+        // Could never be accepted, retrying would not help.
+        respond(socket, "413 Payload Too Large", {{"error", "batch too large"}, {"max_batch", int(burst)}});
+        return;
+    }
+    const double wait = rate > 0 ? takeTokens(socket->peerAddress().toString(), words.length()) : 0;
+    if (wait > 0)
+    {
+        const int retry_after = qCeil(wait);
+        respond(socket, "429 Too Many Requests", {{"error", "rate limit exceeded"}, {"retry_after", retry_after}}, retry_after);
+        return;
+    }
+
+    QJsonArray rejected;
+    int accepted = 0;
+    for (const WordFrequency &item : words)
+    {
+        QString reason;
+        const WordFilter::Verdict verdict = word_filter.check(item.first);
+        if (verdict != WordFilter::Accepted)
+            reason = WordFilter::reason(verdict);
+        else if (item.second < 0)
+            reason = "invalid weight";
+        if (!reason.isEmpty())
+        {
+            rejected.append(QJsonObject{{"word", item.first}, {"reason", reason}});
+            continue;
+        }
+        batch.append({item.first, item.second == 0 ? default_weight : qMin(item.second, qreal(max_weight))});
+        accepted++;
+    }
+    unapplied.fetchAndAddOrdered(accepted);
+    if (!batch.isEmpty() && !flush_timer->isActive())
+        flush_timer->start();
+    respond(socket, "200 OK", {{"accepted", accepted}, {"rejected", rejected}, {"pending", unapplied.loadAcquire()}});
+}
+
+QVector<WordFrequency> IngestServer::parseWords(const QByteArray &body, const bool json) const
+{
+    QVector<WordFrequency> words;
+    if (json)
+    {
+        const QJsonDocument doc = QJsonDocument::fromJson(body);
+        QJsonArray items;
+        if (doc.isArray())
+            items = doc.array();
+        else if (doc.object().contains("words"))
+            items = doc.object().value("words").toArray();
+        else if (doc.isObject())
+            items.append(doc.object());
+        for (const QJsonValue &item : items)
+        {
+            if (item.isString())
+                words.append({item.toString(), 0});
+            else if (item.isObject())
+            {
+                const QJsonValue weight = item.toObject().value("weight");
+                qreal value = 0;
+                if (!weight.isUndefined())
+                    value = weight.isDouble() && weight.toDouble() >= 1 ? qFloor(weight.toDouble()) : -1;
+                words.append({item.toObject().value("word").toString(), value});
+            }
+        }
+    }
+    else
+    {
+        for (const QByteArray &line : body.split('\n'))
+        {
+            const QList<QByteArray> fields = line.simplified().split(' ');
+            if (fields.first().isEmpty())
+                continue;
+            qreal value = 0;
+            if (fields.length() > 1)
+            {
+                bool ok;
+                const int weight = fields[1].toInt(&ok);
+                value = ok && weight >= 1 ? weight : -1;
+            }
+            words.append({QString::fromUtf8(fields.first()), value});
+        }
+    }
+    return words;
+}
+
+double IngestServer::takeTokens(const QString &client, const int number)
+{
+    auto it = buckets.find(client);
+    if (it == buckets.end())
+    {
+        it = buckets.insert(client, {burst, QElapsedTimer()});
+        it->last_update.start();
+    }
+    else
+    {
+        it->tokens = qMin(burst, it->tokens + rate * it->last_update.restart() / 1000.);
+    }
+    if (it->tokens < number)
+        return (number - it->tokens) / rate;
+    it->tokens -= number;
+    return 0;
+}
+
+void IngestServer::respond(QTcpSocket *socket, const QByteArray &status, const QJsonObject &body, const int retry_after)
+{
+    const QByteArray content = QJsonDocument(body).toJson(QJsonDocument::Compact) + "\n";
+    QByteArray header = "HTTP/1.0 " + status + "\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " + QByteArray::number(content.length()) + "\r\n"
+            "Connection: close\r\n";
+    if (retry_after > 0)
+        header += "Retry-After: " + QByteArray::number(retry_after) + "\r\n";
+    socket->write(header + "\r\n" + content);
+    socket->disconnectFromHost();
+}
+
+void IngestServer::flush()
+{
+    if (batch.isEmpty())
+        return;
+    emit wordsReceived(batch);
+    batch.clear();
+}
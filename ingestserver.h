@@ -0,0 +1,100 @@
+#ifndef INGESTSERVER_H
+#define INGESTSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QAtomicInt>
+#include "wordcloudengine.h"
+#include "wordfilter.h"
+
+
+/// Local HTTP server for word submissions of the audience (e.g. from a web
+/// form). It is meant to run in its own thread: requests are parsed and
+/// validated there and accepted words are forwarded in batches by the
+/// signal wordsReceived().
+///
+/// POST /words accepts a JSON object {"word": "...", "weight": 10}, an
+/// object {"words": [...]} or an array of such objects or of plain strings,
+/// or plain text with one word (optionally followed by a weight) per line.
+/// GET /status reports the number of pending words.
+class IngestServer : public QObject
+{
+    Q_OBJECT
+
+    /// Token bucket for rate limiting of one client.
+    struct Bucket
+    {
+        double tokens;
+        QElapsedTimer last_update;
+    };
+
+    QTcpServer *server;
+    /// Timer for flushing accepted words.
+    QTimer *flush_timer;
+    /// Accepted words which were not forwarded yet.
+    QVector<WordFrequency> batch;
+    /// Rate limit buckets by client address.
+    QHash<QString, Bucket> buckets;
+    /// Words are validated by this filter.
+    WordFilter word_filter;
+    /// Words which were accepted but not applied to the word list yet.
+    QAtomicInt unapplied;
+    /// Weight of words without explicit weight.
+    int default_weight = 10;
+    /// Maximum weight of a word.
+    int max_weight = 100;
+    /// Maximum number of unapplied words, further requests are rejected.
+    int max_pending = 10000;
+    /// Maximum sustained number of words per second per client, 0 for no
+    /// limit.
+    double rate = 0.;
+    /// Maximum number of words in a burst per client, which is also the
+    /// maximum size of a batch.
+    double burst = 0.;
+
+    /// Handle a complete request on socket.
+    void handleRequest(QTcpSocket *socket, const QByteArray &method, const QByteArray &path, const QByteArray &body, const bool json);
+    /// Parse words from request body into (word, weight) pairs. Weight 0
+    /// means default weight, negative weight means invalid.
+    QVector<WordFrequency> parseWords(const QByteArray &body, const bool json) const;
+    /// Take tokens from the bucket of client. Returns the time in seconds
+    /// until enough tokens are available, 0 if they were taken. number
+    /// must not exceed burst.
+    double takeTokens(const QString &client, const int number);
+    /// Send HTTP response and close connection.
+    static void respond(QTcpSocket *socket, const QByteArray &status, const QJsonObject &body, const int retry_after = 0);
+
+public:
+    IngestServer(QObject *parent = nullptr);
+    void setWordFilter(const WordFilter &filter) {word_filter = filter;}
+    void setWeights(const int default_value, const int max_value) {default_weight = default_value; max_weight = max_value;}
+    void setMaxPending(const int number) {max_pending = number;}
+    /// Set rate limit in words per second per client, 0 for no limit.
+    /// Batches of up to 5 seconds worth of words are accepted.
+    void setRate(const double words_per_second) {rate = words_per_second; burst = qMax(1., 5*words_per_second);}
+    void setBatchInterval(const int ms) {flush_timer->setInterval(ms);}
+    /// Called (from any thread) when words were applied to the word list.
+    void markApplied(const int number) {unapplied.fetchAndAddOrdered(-number);}
+
+public slots:
+    /// Start listening on localhost.
+    bool listen(const quint16 port);
+
+private slots:
+    void newConnection();
+    void readRequest();
+    /// Forward accepted words.
+    void flush();
+
+signals:
+    /// A batch of validated words was received.
+    void wordsReceived(const QVector<WordFrequency> &words);
+};
+
+#endif // INGESTSERVER_H
@@ -1,24 +1,48 @@
 #include "mainwindow.h"
+#include <QtConcurrent>
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QDir>
+#include <QMutex>
+#include <QShortcut>
+#include <QJsonArray>
+#include <QPixmapCache>
+#include "maskrasterizer.h"
+#include "sequencerenderer.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QWidget(parent),
-    view(new QGraphicsView()),
+    view(new OutputView()),
     scene(new QGraphicsScene(this)),
-    videoitem(new QGraphicsVideoItem()),
-    picitem_fg(new QQGraphicsPixmapItem()),
+    videoitem(new VideoSurfaceItem()),
+    crossfade(new CrossfadeItem()),
     picitem(new QQGraphicsPixmapItem()),
     player(new QMediaPlayer()),
-    playlist(new QMediaPlaylist),
+    pool(new PlayerPool(scene, player, videoitem)),
     video_timer(new QTimer()),
     anim_group(new QParallelAnimationGroup()),
     video_anim(new QPropertyAnimation(videoitem, "opacity")),
     audio_anim(new QPropertyAnimation(player, "volume")),
     pic_fade_anim(new QPropertyAnimation(picitem, "opacity")),
-    pic_change_anim(new QPropertyAnimation(picitem_fg, "opacity")),
+    pic_change_anim(new QPropertyAnimation(crossfade, "progress")),
+    playlist(new PlaylistModel(this)),
+    playlist_filter(new QSortFilterProxyModel(this)),
+    playlist_view(new QListView(this)),
+    searchedit(new QLineEdit(this)),
+    prober(new MediaProber(this)),
+    seeker(new SeekController(this)),
     process(new QProcess(this)),
+    wordstore(new WordStore(this)),
+    generator_watcher(new QFutureWatcher<QImage>(this)),
+    image_watcher(new QFutureWatcher<QImage>(this)),
+    scheduler(new UpdateScheduler(this)),
+    cloud_cache(new CloudCache(this)),
+    history_box(new QComboBox(this)),
     lineedit(new QLineEdit(this)),
     weightedit(new QLineEdit(this)),
     slider(new QSlider(Qt::Horizontal, this)),
+    scrub_preview(new QLabel(this)),
     logerr(new QLabel(this))
 {
     // Create the layout for main window.
@@ -38,9 +62,32 @@ MainWindow::MainWindow(QWidget *parent) :
     }
 
     {
+        QWidget *button_widget = new QWidget(this);
+        QHBoxLayout *button_layout = new QHBoxLayout(button_widget);
+        layout()->addWidget(button_widget);
         QPushButton *button = new QPushButton("update", this);
         connect(button, &QPushButton::released, this, &MainWindow::updateWordcloud);
-        layout()->addWidget(button);
+        button_layout->addWidget(button, 4);
+        button = new QPushButton("re-layout", this);
+        connect(button, &QPushButton::released, this, &MainWindow::relayoutWordcloud);
+        button_layout->addWidget(button, 1);
+    }
+
+    // History of word cloud states.
+    {
+        QWidget *history_widget = new QWidget(this);
+        QHBoxLayout *history_layout = new QHBoxLayout(history_widget);
+        layout()->addWidget(history_widget);
+        QPushButton *button = new QPushButton("undo", this);
+        connect(button, &QPushButton::released, this, &MainWindow::undo);
+        history_layout->addWidget(button, 1);
+        button = new QPushButton("redo", this);
+        connect(button, &QPushButton::released, this, &MainWindow::redo);
+        history_layout->addWidget(button, 1);
+        connect(history_box, QOverload<int>::of(&QComboBox::activated), this, &MainWindow::jumpToState);
+        history_layout->addWidget(history_box, 3);
+        connect(new QShortcut(QKeySequence::Undo, this), &QShortcut::activated, this, &MainWindow::undo);
+        connect(new QShortcut(QKeySequence::Redo, this), &QShortcut::activated, this, &MainWindow::redo);
     }
 
     {
@@ -53,16 +100,31 @@ MainWindow::MainWindow(QWidget *parent) :
 
     {
         QPushButton *button = new QPushButton("stop video", this);
-        connect(button, &QPushButton::released, this, &MainWindow::fadeOut);
+        connect(button, &QPushButton::released, this, &MainWindow::stopVideo);
         layout()->addWidget(button);
     }
 
-    // Configure appearence of output widget.
-    view->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    view->setStyleSheet("border: 0px");
+    // Video selection.
+    {
+        pool->setPlaylist(playlist);
+        playlist->setProber(prober);
+        playlist_filter->setSourceModel(playlist);
+        playlist_filter->setFilterCaseSensitivity(Qt::CaseInsensitive);
+        searchedit->setPlaceholderText("search video");
+        searchedit->setClearButtonEnabled(true);
+        connect(searchedit, &QLineEdit::textChanged, playlist_filter, &QSortFilterProxyModel::setFilterFixedString);
+        connect(searchedit, &QLineEdit::returnPressed, this, &MainWindow::chooseFirstMatch);
+        layout()->addWidget(searchedit);
+        playlist_view->setModel(playlist_filter);
+        // All rows have the same height, so only visible rows are laid out.
+        playlist_view->setUniformItemSizes(true);
+        playlist_view->setIconSize(QSize(160, 90));
+        playlist_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        connect(playlist_view, &QListView::clicked, this, &MainWindow::chooseVideo);
+        layout()->addWidget(playlist_view);
+    }
+
     view->setScene(scene);
-    view->setBackgroundBrush(QBrush(Qt::black));
 
     // Prepare animation group.
     anim_group->addAnimation(video_anim);
@@ -76,43 +138,86 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Prepare background image of word cloud.
     scene->addItem(picitem);
+    // Below the videos, see PlayerPool.
+    picitem->setZValue(0);
     picitem->show();
-    scene->addItem(picitem_fg);
-
-    // Configure video widget and media player.
-    player->setPlaylist(playlist);
-    playlist->setPlaybackMode(QMediaPlaylist::CurrentItemOnce);
-    player->setVideoOutput(videoitem);
-    scene->addItem(videoitem);
-    videoitem->hide();
-    connect(slider, &QSlider::sliderMoved, this, &MainWindow::setVideoPosition);
+    // The transition is a child of picitem, so it fades with the word cloud.
+    crossfade->setParentItem(picitem);
+    // Release the old image when the transition has finished.
+    connect(pic_change_anim, &QPropertyAnimation::finished, this, [this](){crossfade->clear();});
+
+    // Configure video widget and media player. The pool adds videoitem to
+    // the scene.
+    // While dragging, seeks snap to keyframes and are coalesced. Releasing
+    // the slider seeks exactly.
+    seeker->setPlayer(player);
+    connect(slider, &QSlider::sliderMoved, seeker, &SeekController::scrub);
+    connect(slider, &QSlider::sliderReleased, this, &MainWindow::sliderReleased);
+    connect(seeker, &SeekController::previewChanged, this, [this](const QImage &image)
+    {
+        scrub_preview->setPixmap(QPixmap::fromImage(image));
+        scrub_preview->setVisible(!image.isNull());
+    });
+    connect(prober, &MediaProber::probed, this, [this](const QString &path)
+    {
+        if (playing_index >= 0 && playlist->path(playing_index) == path)
+            seeker->setMedia(path, prober->info(path).keyframes);
+    });
     connect(player, &QMediaPlayer::durationChanged, slider, &QSlider::setMaximum);
-    connect(player, &QMediaPlayer::positionChanged, slider, &QSlider::setValue);
+    connect(player, &QMediaPlayer::durationChanged, this, &MainWindow::scheduleFadeOut);
+    connect(player, &QMediaPlayer::positionChanged, this, &MainWindow::showVideoPosition);
+    connect(player, &QMediaPlayer::stateChanged, this, &MainWindow::playerStatusChanged);
+    connect(player, &QMediaPlayer::mediaStatusChanged, this, &MainWindow::playerStatusChanged);
+
+    // Measure frame rate of animations and stalls of the event loop.
+    new AnimationMonitor(video_anim, "video_fade", this);
+    new AnimationMonitor(pic_change_anim, "image_change", this);
+    new StallMonitor(this);
 
     // Prepare video timer (which triggers the fade out).
     video_timer->setSingleShot(true);
     connect(video_timer, &QTimer::timeout, this, &MainWindow::fadeOut);
 
-    connect(process, SIGNAL(finished(int)), this, SLOT(updatePixmap(int)));
+    connect(process, SIGNAL(finished(int)), this, SLOT(processFinished(int)));
+    connect(process, &QProcess::readyReadStandardOutput, this, &MainWindow::readProcessOutput);
+    connect(process, &QProcess::errorOccurred, this, &MainWindow::processError);
+    connect(generator_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::generationFinished);
+    connect(image_watcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::imagePrepared);
+    connect(scheduler, &UpdateScheduler::generate, this, &MainWindow::startGeneration);
+    Trace::installSignalHandlers(this);
 }
 
 MainWindow::~MainWindow()
 {
+    if (ingest_thread != nullptr)
+    {
+        ingest_thread->quit();
+        ingest_thread->wait();
+        delete ingest_server;
+    }
+    if (process->state() != QProcess::NotRunning)
+    {
+        // Ask the word cloud worker to quit.
+        process->write("quit\n");
+        if (!process->waitForFinished(1000))
+            process->kill();
+    }
     delete pic_fade_anim;
     delete pic_change_anim;
     delete video_anim;
     delete audio_anim;
     delete anim_group;
     delete video_timer;
-    delete player;
-    delete playlist;
+    delete pool;
     delete scene;
     delete view;
+    qDeleteAll(outputs);
 }
 
 
 void MainWindow::play()
 {
+    TraceSpan span("play");
     // Configure animation.
     video_anim->setDuration(fade_in_duration);
     video_anim->setStartValue(0.);
@@ -130,38 +235,69 @@ void MainWindow::play()
     videoitem->setOpacity(0.);
     player->play();
     videoitem->show();
+    startAnimation();
+}
+
+void MainWindow::startAnimation()
+{
+    Trace::instant("anim_group_start");
+    trace_anim_start = Trace::enabled() ? Trace::now() : -1;
     anim_group->start();
 }
 
 void MainWindow::videoAnimEnded()
 {
+    if (trace_anim_start >= 0)
+        Trace::complete("anim_group", trace_anim_start);
+    trace_anim_start = -1;
     if (video_anim->endValue().toReal() > 0.5)
     {
         // The animation was fading in.
-        if (player->duration() == 0)
-            return;
-        if (player->duration() - player->position() <= fade_out_duration)
-        {
-            // Alreadt time to fade out.
-            fadeOut();
-        }
-        else
-        {
-            // No need to fade out yet. Update video_timer now in order to fade out in time.
-            video_timer->setInterval(player->duration() - player->position() - fade_out_duration);
-            video_timer->start();
-        }
+        scheduleFadeOut();
     }
     else
     {
-        // The animation was fading out.
-        player->stop();
-        videoitem->hide();
+        // The animation was fading out. Park the player at the beginning of
+        // the video again.
+        pool->release();
+        playing_index = -1;
         slider->setValue(0);
         slider->setMaximum(1);
     }
 }
 
+void MainWindow::scheduleFadeOut()
+{
+    // Only while the video is shown and not fading.
+    if (!videoitem->isVisible() || video_anim->state() == QAbstractAnimation::Running || video_anim->endValue().toReal() < 0.5)
+        return;
+    if (player->state() != QMediaPlayer::PlayingState)
+        return;
+    // If the duration is unknown, this is called again by durationChanged.
+    const qint64 duration = videoDuration();
+    if (duration <= 0)
+        return;
+    if (duration - player->position() <= fade_out_duration)
+    {
+        // Already time to fade out.
+        fadeOut();
+    }
+    else
+    {
+        // No need to fade out yet. Update video_timer now in order to fade out in time.
+        video_timer->start(duration - player->position() - fade_out_duration);
+    }
+}
+
+qint64 MainWindow::videoDuration() const
+{
+    if (player->duration() > 0)
+        return player->duration();
+    if (playing_index < 0 || playing_index >= playlist->rowCount())
+        return 0;
+    return prober->info(playlist->path(playing_index)).duration;
+}
+
 void MainWindow::fadeOut()
 {
     if (!videoitem->isVisible())
@@ -180,95 +316,383 @@ void MainWindow::fadeOut()
     pic_fade_anim->setEndValue(1.);
     pic_fade_anim->setEasingCurve(QEasingCurve::OutQuad);
     // Start animation.
-    anim_group->start();
+    startAnimation();
+}
+
+void MainWindow::stopVideo()
+{
+    recorder.record("stop");
+    fadeOut();
+}
+
+void MainWindow::applyReplayEvent(const QJsonObject &data)
+{
+    const QString type = data.value("type").toString();
+    if (type == "word")
+    {
+        // Entered like by the operator, including validation.
+        lineedit->setText(data.value("word").toString());
+        weightedit->setText(data.value("weight").toString());
+        // Counted before, because the generation may start immediately.
+        if (!lineedit->text().isEmpty())
+            replayer->wordsAdded(1);
+        updateWordcloud();
+        if (!lineedit->text().isEmpty())
+        {
+            replayer->wordRejected(true);
+            lineedit->clear();
+            weightedit->setText(QString::number(defaultweight));
+        }
+    }
+    else if (type == "words")
+    {
+        QVector<WordFrequency> words;
+        for (const QJsonValue &item : data.value("words").toArray())
+        {
+            const QJsonArray pair = item.toArray();
+            const QString word = pair.at(0).toString();
+            if (word_filter.check(word) == WordFilter::Accepted)
+                words.append({word, pair.at(1).toDouble()});
+            else
+                replayer->wordRejected();
+        }
+        replayer->wordsAdded(words.length());
+        addAudienceWords(words);
+    }
+    else if (type == "relayout")
+        relayoutWordcloud();
+    else if (type == "history")
+        jumpToState(data.value("position").toInt());
+    else if (type == "select" || type == "mark")
+    {
+        const QString path = data.value("path").toString();
+        const int index = path.isEmpty() ? -1 : playlist->paths().indexOf(path);
+        if (index == -1 && (type == "select" || !path.isEmpty()))
+            qWarning() << "Replayed video is not in the playlist:" << path;
+        else if (type == "mark")
+            markUpNext(index);
+        else
+            startVideo(index);
+    }
+    else if (type == "stop")
+        stopVideo();
+    else if (type == "pause")
+        playPauseVideo();
+    else if (type == "seek")
+        setVideoPosition(data.value("position").toVariant().toLongLong());
+    else
+        qWarning() << "Unknown event in session log:" << type;
+}
+
+void MainWindow::processFinished(const int exitcode)
+{
+    Trace::instant("process_finish", exitcode);
+    if (program_oneshot)
+    {
+        generationCompleted();
+        if (exitcode == 0 && save_image)
+            writeContentHash(pixmap_path, generation_hash);
+        updatePixmap(exitcode);
+        scheduler->finished();
+    }
+    else
+    {
+        // The worker should keep running. It is restarted with the next update.
+        qWarning() << "Word cloud generator exited with code" << exitcode;
+        logerr->setText("<b>Word cloud generator exited</b>");
+        scheduler->finished();
+    }
+}
+
+void MainWindow::processError(const QProcess::ProcessError error)
+{
+    // Other errors are followed by finished().
+    if (error != QProcess::FailedToStart)
+        return;
+    qWarning() << "Could not start word cloud generator" << program_path << process->errorString();
+    logerr->setText("<b>Could not start word cloud generator:</b> " + process->errorString().toHtmlEscaped());
+    // The worker never answers the pending request, the next update starts
+    // it again.
+    shown_seq = requested_seq;
+    generationCompleted();
+    scheduler->finished();
+}
+
+void MainWindow::readProcessOutput()
+{
+    while (process->canReadLine())
+    {
+        const QString line = QString::fromUtf8(process->readLine()).trimmed();
+        const QStringList fields = line.split(' ');
+        if (fields.length() >= 2 && fields[0] == "done")
+        {
+            const quint64 seq = fields[1].toULongLong();
+            qDebug() << "word cloud generator finished update" << seq;
+            Trace::instant("process_done");
+            // Replies arrive in order, but be safe against stale images.
+            if (seq > shown_seq)
+            {
+                shown_seq = seq;
+                if (!showSharedImage())
+                    loadPixmap();
+            }
+            if (seq == requested_seq)
+            {
+                generationCompleted();
+                if (save_image)
+                    writeContentHash(pixmap_path, generation_hash);
+                scheduler->finished();
+            }
+        }
+        else if (fields[0] == "error")
+        {
+            qWarning() << "Word cloud generator failed:" << line;
+            logerr->setText("<b>Word cloud generation failed</b>");
+            if (fields.length() >= 2 && fields[1].toULongLong() == requested_seq)
+                scheduler->finished();
+        }
+        else if (!line.isEmpty())
+            qDebug() << "word cloud generator:" << line;
+    }
 }
 
 void MainWindow::updatePixmap(const int exitcode)
 {
+    TraceSpan span("updatePixmap");
     qDebug() << "updating pixmap";
     if (exitcode != 0)
     {
         qDebug() << "Python returned exit code" << exitcode;
         return;
     }
+    if (showSharedImage())
+        return;
     QFileInfo file = QFileInfo(pixmap_path);
     if (file.lastModified() != last_modified)
+        loadPixmap();
+}
+
+void MainWindow::loadPixmap()
+{
+    last_modified = QFileInfo(pixmap_path).lastModified();
+    const QString path = pixmap_path;
+    prepareImage([path]()
+    {
+        QImage image;
+        if (!image.load(path))
+            qWarning() << "Could not load word cloud image:" << path;
+        return image;
+    }, generation_hash);
+}
+
+void MainWindow::prepareImage(const std::function<QImage()> &source, const QByteArray &cache_key)
+{
+    if (image_watcher->isRunning())
+    {
+        // Only the newest image is relevant.
+        pending_image_source = source;
+        pending_image_key = cache_key;
+        return;
+    }
+    preparing_key = cache_key;
+    image_watcher->setFuture(QtConcurrent::run([source]()
+    {
+        TraceSpan span("load_image");
+        const QImage image = source();
+        if (image.format() == QImage::Format_ARGB32_Premultiplied)
+            // Make sure that the image does not refer to external memory.
+            return image.copy();
+        return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }));
+}
+
+void MainWindow::imagePrepared()
+{
+    const QImage image = image_watcher->result();
+    if (!image.isNull())
     {
-        last_modified = file.lastModified();
-        QPixmap pixmap;
-        pixmap.load(pixmap_path);
-        if (videoitem->isVisible() && videoitem->opacity() > 0)
+        cloud_cache->insert(preparing_key, image);
+        if (isCurrentState(preparing_key))
         {
-            picitem->setPixmap(pixmap);
+            showPixmap(QPixmap::fromImage(image));
+            if (replayer != nullptr)
+                replayer->wordcloudShown();
         }
-        else {
-            // Animate the transition between new and old image.
-            // picitem_fg contains the old image, which fades out while
-            // picitem already contains the new image.
-            picitem_fg->setPixmap(picitem->pixmap());
-            picitem_fg->show();
-            picitem->setPixmap(pixmap);
+    }
+    if (pending_image_source)
+    {
+        const std::function<QImage()> source = pending_image_source;
+        pending_image_source = nullptr;
+        prepareImage(source, pending_image_key);
+    }
+}
+
+bool MainWindow::showSharedImage()
+{
+    if (shm_path.isEmpty() || !shared_image.open(shm_path))
+        return false;
+    const quint64 generation = shared_image.generation();
+    if (generation == 0)
+        return false;
+    if (generation != shown_generation)
+    {
+        shown_generation = generation;
+        // The image refers to the shared memory, it is copied in a worker
+        // thread. The generator only overwrites it two generations later.
+        const QImage image = shared_image.image();
+        prepareImage([image](){return image;}, generation_hash);
+    }
+    return true;
+}
+
+void MainWindow::showPixmap(const QPixmap &pixmap)
+{
+    TraceSpan span("swap_pixmap");
+    if (generation_submission_timer.isValid())
+    {
+        Metrics::instance().observe("word_to_pixmap_ms", generation_submission_timer.elapsed());
+        generation_submission_timer.invalidate();
+    }
+    if (videoitem->isVisible() && videoitem->opacity() > 0)
+    {
+        picitem->setPixmap(pixmap);
+    }
+    else {
+        // Animate the transition between new and old image.
+        // crossfade blends from the old to the new image where they differ,
+        // while picitem already contains the new image.
+        pic_change_anim->stop();
+        const bool blend = crossfade->start(picitem->pixmap().toImage(), pixmap.toImage());
+        picitem->setPixmap(pixmap);
+        if (blend)
+        {
             pic_change_anim->setDuration(picture_change_duration);
             pic_change_anim->setEasingCurve(QEasingCurve::InOutQuad);
-            pic_change_anim->setStartValue(1.);
-            pic_change_anim->setEndValue(0.);
+            pic_change_anim->setStartValue(0.);
+            pic_change_anim->setEndValue(1.);
             pic_change_anim->start();
         }
     }
 }
 
-void MainWindow::loadJson(const QString json_path)
+void MainWindow::chooseFirstMatch()
+{
+    if (playlist_filter->rowCount() > 0)
+        chooseVideo(playlist_filter->index(0, 0));
+}
+
+void MainWindow::chooseVideo(const QModelIndex &index)
 {
-    QFile json_file(json_path);
-    if (!json_file.exists())
+    TraceSpan span("chooseVideo");
+    const int idx = playlist_filter->mapToSource(index).row();
+    if (idx == -1)
     {
-        qWarning() << "File not found:" << json_path;
+        qWarning() << "Invalid video selected.";
         return;
     }
-    json_file.open(QFile::ReadOnly);
-    const QJsonDocument doc = QJsonDocument::fromJson(json_file.readAll());
-    if (doc.isNull() || doc.isEmpty())
+    if (QApplication::keyboardModifiers() & Qt::ControlModifier)
     {
-        qWarning() << "File is empty or loading failed:" << json_path;
+        markUpNext(idx == up_next ? -1 : idx);
+        recorder.record("mark", {{"path", up_next == -1 ? QString() : playlist->path(up_next)}});
         return;
     }
-    QJsonObject obj = doc.object();
-    for (auto it = obj.constBegin(); it != obj.constEnd(); ++it)
+    recorder.record("select", {{"path", playlist->path(idx)}, {"title", playlist->title(idx)}});
+    startVideo(idx);
+}
+
+void MainWindow::startVideo(const int idx)
+{
+    anim_group->stop();
+    video_timer->stop();
+    video_start_timer.start();
+    PlayerPool::Entry *entry = pool->acquire(idx);
+    if (entry == nullptr)
+        return;
+    playing_index = idx;
+    setActivePlayer(entry);
+    if (idx == up_next)
+        markUpNext(-1);
+    play();
+    prerollCandidates(idx);
+}
+
+void MainWindow::setActivePlayer(PlayerPool::Entry *entry)
+{
+    if (entry->player != player)
     {
-        playlist->addMedia(QUrl::fromLocalFile(it->toString()));
-        QPushButton *button = new QPushButton(it.key(), this);
-        video_buttons.append(button);
-        connect(button, &QPushButton::released, this, &MainWindow::chooseVideo);
-        layout()->addWidget(button);
+        disconnect(player, nullptr, slider, nullptr);
+        disconnect(player, nullptr, this, nullptr);
+        player = entry->player;
+        connect(player, &QMediaPlayer::durationChanged, slider, &QSlider::setMaximum);
+        connect(player, &QMediaPlayer::durationChanged, this, &MainWindow::scheduleFadeOut);
+        connect(player, &QMediaPlayer::positionChanged, this, &MainWindow::showVideoPosition);
+        connect(player, &QMediaPlayer::stateChanged, this, &MainWindow::playerStatusChanged);
+        connect(player, &QMediaPlayer::mediaStatusChanged, this, &MainWindow::playerStatusChanged);
+        seeker->setPlayer(player);
     }
+    if (playing_index >= 0)
+        seeker->setMedia(playlist->path(playing_index), prober->info(playlist->path(playing_index)).keyframes);
+    videoitem = entry->item;
+    video_anim->setTargetObject(videoitem);
+    audio_anim->setTargetObject(player);
+    slider->setMaximum(qMax(qint64(1), videoDuration()));
+    slider->setValue(player->position());
 }
 
-void MainWindow::chooseVideo()
+void MainWindow::prerollCandidates(const int index)
 {
-    if (sender() == nullptr)
+    // The video marked by the operator has the highest priority.
+    int remaining = preroll_count;
+    if (up_next != -1 && up_next != index && remaining > 0)
     {
-        qWarning() << "chooseVideo() should not be called directly, but only by events from buttons.";
-        return;
+        pool->preroll(up_next);
+        remaining--;
     }
-    const int idx = video_buttons.indexOf(static_cast<QPushButton*>(sender()), 0);
-    if (idx == -1)
+    for (int i=index+1; remaining>0 && i<pool->mediaCount(); i++)
     {
-        qWarning() << "Could not find out which button was pushed.";
+        if (i == up_next)
+            continue;
+        pool->preroll(i);
+        remaining--;
+    }
+}
+
+void MainWindow::playerStatusChanged()
+{
+    Trace::instant("media_status", player->mediaStatus());
+    Trace::instant("player_state", player->state());
+    if (!video_start_timer.isValid() || player->state() != QMediaPlayer::PlayingState)
         return;
+    if (player->mediaStatus() == QMediaPlayer::BufferedMedia || player->mediaStatus() == QMediaPlayer::LoadedMedia)
+    {
+        Metrics::instance().observe("video_start_ms", video_start_timer.elapsed());
+        video_start_timer.invalidate();
     }
-    playlist->setCurrentIndex(idx);
-    play();
+}
+
+void MainWindow::updateMetricsOverlay()
+{
+    metrics_overlay->setText(Metrics::instance().summary());
+}
+
+void MainWindow::markUpNext(const int index)
+{
+    up_next = index;
+    playlist->setUpNext(index);
+    if (up_next >= 0)
+        pool->preroll(up_next);
 }
 
 void MainWindow::updateWordcloud()
 {
+    TraceSpan span("updateWordcloud");
+    recorder.record("word", {{"word", lineedit->text()}, {"weight", weightedit->text()}});
     logerr->setText("");
     if (!lineedit->text().isEmpty())
     {
-        if (word_regex.exactMatch(lineedit->text()))
+        const WordFilter::Verdict verdict = word_filter.check(lineedit->text());
+        if (verdict == WordFilter::Accepted)
         {
-            QFile file(wordlist_path);
-            file.open(QFile::Append);
             bool ok;
             int weight = weightedit->text().toUInt(&ok);
             if (!ok)
@@ -280,32 +704,377 @@ void MainWindow::updateWordcloud()
             }
             else if (weight > maxweight)
                 weight = maxweight;
-            const QByteArray rawtext = (lineedit->text() + " ").toUtf8();
-            while (weight-- > 0)
-                file.write(rawtext);
-            file.write("\n");
-            file.close();
+            addWord(lineedit->text(), weight);
             lineedit->clear();
             weightedit->setText(QString::number(defaultweight));
         }
         else
         {
-            qWarning() << "Invalid word:" << lineedit->text();
-            logerr->setText("<b>Ignored input:</b> Invalid word.");
+            qWarning() << "Rejected word:" << lineedit->text() << WordFilter::reason(verdict);
+            logerr->setText("<b>Ignored input:</b> " + lineedit->text().toHtmlEscaped() + " (" + WordFilter::reason(verdict) + ")");
             return;
         }
     }
-    process->start();
+    requestUpdate();
 }
 
-void MainWindow::initParameters(const QCommandLineParser &parser)
+void MainWindow::ingestWords(const QVector<WordFrequency> &words)
+{
+    addAudienceWords(words);
+    ingest_server->markApplied(words.length());
+}
+
+void MainWindow::addAudienceWords(const QVector<WordFrequency> &words)
+{
+    QJsonArray batch;
+    for (const WordFrequency &item : words)
+    {
+        addWord(item.first, item.second);
+        batch.append(QJsonArray{item.first, item.second});
+    }
+    recorder.record("words", {{"words", batch}});
+    qDebug() << "received" << words.length() << "words from audience";
+    requestUpdate();
+}
+
+void MainWindow::addWord(const QString &word, const qreal weight)
+{
+    wordstore->add(word, weight);
+    pending_changes.append({word, weight});
+}
+
+void MainWindow::recordState()
+{
+    if (pending_changes.isEmpty() && history_position >= 0 && history[history_position].key == generation_hash)
+        return;
+    HistoryState state;
+    state.key = generation_hash;
+    state.changes = pending_changes;
+    if (history_position < 0)
+        state.label = "start";
+    else if (pending_changes.length() == 1)
+        state.label = QString("+%1 (%2)").arg(pending_changes.first().first).arg(pending_changes.first().second);
+    else
+        state.label = QString("+%1 words").arg(pending_changes.length());
+    state.label = QTime::currentTime().toString("HH:mm:ss ") + state.label;
+    pending_changes.clear();
+    // A new state discards the states which could be restored by redo.
+    history.resize(history_position + 1);
+    history.append(state);
+    if (history.length() > max_history)
+    {
+        history.removeFirst();
+        // The first state cannot be undone.
+        history.first().changes.clear();
+    }
+    history_position = history.length() - 1;
+    updateHistoryBox();
+}
+
+void MainWindow::undo()
+{
+    jumpToState(pending_changes.isEmpty() ? history_position - 1 : history_position);
+}
+
+void MainWindow::redo()
+{
+    jumpToState(history_position + 1);
+}
+
+void MainWindow::jumpToState(const int position)
+{
+    if (position < 0 || position >= history.length())
+        return;
+    // Changes of the word list, recorded such that the session log contains
+    // the complete word list history.
+    QJsonArray changes;
+    const auto change = [this, &changes](const QString &word, const qreal weight)
+    {
+        wordstore->add(word, weight);
+        changes.append(QJsonArray{word, weight});
+    };
+    // Words which are not part of a state yet are discarded.
+    for (const WordFrequency &item : pending_changes)
+        change(item.first, -item.second);
+    pending_changes.clear();
+    for (; history_position > position; history_position--)
+        for (const WordFrequency &item : history[history_position].changes)
+            change(item.first, -item.second);
+    while (history_position < position)
+    {
+        history_position++;
+        for (const WordFrequency &item : history[history_position].changes)
+            change(item.first, item.second);
+    }
+    recorder.record("history", {{"position", position}, {"changes", changes}});
+    qDebug() << "restored word cloud state" << history[history_position].label;
+    updateHistoryBox();
+    showState();
+}
+
+bool MainWindow::isCurrentState(const QByteArray &key) const
+{
+    return history_position < 0 || history[history_position].key == key;
+}
+
+void MainWindow::showState()
+{
+    const QByteArray key = history[history_position].key;
+    const QImage image = cloud_cache->find(key);
+    if (!image.isNull())
+    {
+        showPixmap(QPixmap::fromImage(image));
+        return;
+    }
+    const std::function<QImage()> loader = cloud_cache->loader(key);
+    if (loader)
+        prepareImage(loader, key);
+    else
+        // Evicted from the cache, generate it again.
+        requestUpdate();
+}
+
+void MainWindow::updateHistoryBox()
+{
+    const QSignalBlocker blocker(history_box);
+    history_box->clear();
+    for (const HistoryState &state : history)
+        history_box->addItem(state.label);
+    history_box->setCurrentIndex(history_position);
+}
+
+void MainWindow::requestUpdate()
+{
+    // In progressive mode, an outdated full resolution layout is cancelled
+    // and the preview of the new state is shown instead.
+    if (progressive && !use_program && scheduler->isRunning())
+        generation_cancel.storeRelease(1);
+    if (!submission_timer.isValid())
+        submission_timer.start();
+    if (replayer != nullptr)
+        replayer->updateRequested();
+    scheduler->submit();
+}
+
+void MainWindow::relayoutWordcloud()
+{
+    recorder.record("relayout");
+    relayout_requested = true;
+    requestUpdate();
+}
+
+void MainWindow::startGeneration()
+{
+    TraceSpan span("startGeneration");
+    trace_generation_start = Trace::enabled() ? Trace::now() : -1;
+    generation_hash = contentHash();
+    recordState();
+    if (replayer != nullptr)
+        replayer->generationStarted();
+    if (submission_timer.isValid())
+    {
+        if (!generation_submission_timer.isValid())
+            generation_submission_timer = submission_timer;
+        submission_timer.invalidate();
+    }
+    if (use_program)
+    {
+        wordstore->exportFrequencies(frequencies_path);
+        if (program_oneshot)
+        {
+            Trace::instant("process_start");
+            process->start();
+        }
+        else
+        {
+            if (process->state() == QProcess::NotRunning)
+            {
+                Trace::instant("process_start");
+                process->start();
+            }
+            process->write("regenerate " + QByteArray::number(++requested_seq) + "\n");
+        }
+        return;
+    }
+    WordCloudEngine engine_copy = engine;
+    generation_cancel.storeRelease(0);
+    engine_copy.setCancelFlag(&generation_cancel);
+    const QVector<WordFrequency> frequencies = wordstore->frequencies();
+    // The scheduler makes sure that only one generation accesses cloud_layout
+    // and preview_layout.
+    WordCloudLayout *layout = &cloud_layout;
+    const bool full = relayout_requested;
+    relayout_requested = false;
+    generation_full = full;
+    WordCloudEngine preview_engine;
+    WordCloudLayout *preview = nullptr;
+    if (progressive)
+    {
+        preview_engine = engine_copy.scaled(preview_scale);
+        preview_engine.setTimeBudget(preview_budget);
+        preview = &preview_layout;
+    }
+    generator_watcher->setFuture(QtConcurrent::run([this, engine_copy, preview_engine, frequencies, layout, preview, full]()
+    {
+        TraceSpan span("layout");
+        if (preview != nullptr)
+        {
+            // Coarse layout within a time budget, shown until the full
+            // resolution layout is done.
+            preview_engine.layoutFull(frequencies, *preview);
+            const QImage image = preview->image.scaled(engine_copy.outputSize(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            QMetaObject::invokeMethod(this, [this, image](){showPreview(image);}, Qt::QueuedConnection);
+        }
+        if (full)
+            engine_copy.layoutFull(frequencies, *layout);
+        else if (!engine_copy.layoutIncremental(frequencies, *layout))
+            qDebug() << "word cloud saturated, did full layout";
+        if (generation_cancel.loadAcquire())
+            // Outdated, the layout is completed by the next generation.
+            return QImage();
+        return layout->image;
+    }));
+}
+
+void MainWindow::generationCompleted()
+{
+    if (trace_generation_start >= 0)
+        Trace::complete("generation", trace_generation_start);
+    trace_generation_start = -1;
+}
+
+void MainWindow::showPreview(const QImage &image)
+{
+    if (generator_watcher->isRunning() && !generation_cancel.loadAcquire() && isCurrentState(generation_hash))
+        showPixmap(QPixmap::fromImage(image));
+}
+
+void MainWindow::generationFinished()
+{
+    generationCompleted();
+    const QImage image = generator_watcher->result();
+    if (image.isNull())
+    {
+        // Cancelled by a newer submission.
+        Metrics::instance().increment("cancelled_generations_total");
+        if (replayer != nullptr)
+            replayer->generationCancelled();
+        if (generation_full)
+            relayout_requested = true;
+        scheduler->finished();
+        return;
+    }
+    cloud_cache->insert(generation_hash, image);
+    if (isCurrentState(generation_hash))
+    {
+        showPixmap(QPixmap::fromImage(image));
+        if (replayer != nullptr)
+            replayer->wordcloudShown();
+    }
+    scheduler->finished();
+    if (save_image)
+    {
+        // Keep the image on disk such that it is available after a restart.
+        const QString output = pixmap_path;
+        const QByteArray hash = generation_hash;
+        static quint64 save_counter = 0;
+        const quint64 seq = ++save_counter;
+        QtConcurrent::run([image, output, hash, seq]()
+        {
+            // Image and hash must belong together, and an older image must
+            // not overwrite a newer one.
+            static QMutex mutex;
+            static quint64 saved_seq = 0;
+            QMutexLocker locker(&mutex);
+            if (seq < saved_seq)
+                return;
+            saved_seq = seq;
+            if (image.save(output))
+                writeContentHash(output, hash);
+        });
+    }
+}
+
+QByteArray MainWindow::contentHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(wordstore->contentHash()));
+    hash.addData(mask_hash);
+    hash.addData(QByteArray::number(window_size.width()) + "x" + QByteArray::number(window_size.height()));
+    hash.addData(use_program ? program_path.toUtf8() : QByteArray("built-in"));
+    return hash.result().toHex();
+}
+
+void MainWindow::writeContentHash(const QString &image_path, const QByteArray &hash)
+{
+    QSaveFile file(image_path + ".hash");
+    if (!file.open(QFile::WriteOnly) || file.write(hash + "\n") < 0 || !file.commit())
+        qWarning() << "Could not write" << image_path + ".hash";
+}
+
+void MainWindow::addOptions(QCommandLineParser &parser)
+{
+    parser.addOptions({
+                          {{"W", "width"}, "screen width in pixels", "int"},
+                          {{"H", "height"}, "screen height in pixels", "int"},
+                          {"playlist", "playist json file path", "file"},
+                          {"mask", "mask image file path (PNG or SVG, which is rasterized at screen size)", "file"},
+                          {"wordlist", "plain text word list file path, imported if the word store is empty", "file"},
+                          {"wordstore", "path prefix of word store journal and snapshot (default: /tmp/wordstore)", "file"},
+                          {"media_cache", "directory for cached video metadata and thumbnails (default: /tmp/videoswitch-media)", "file"},
+                          {"image", "word cloud image file path", "file"},
+                          {"no_image_output", "do not write generated word cloud images to the image file"},
+                          {"shm", "shared memory file for raw images of external word cloud generator (default: /dev/shm/videoswitch-wordcloud)", "file"},
+                          {"program", "external word cloud generator script file path (default: built-in generator)", "file"},
+                          {"program_oneshot", "start external word cloud generator for each update instead of keeping it running"},
+                          {"regex", "regular expression for valid words (default: \\w[\\w']+)", "string"},
+                          {"stopwords", "file with words which are ignored, one per line", "file"},
+                          {"blocklist", "file with terms which are not allowed anywhere in a word, one per line", "file"},
+                          {"max_weight", "maximum weight of word added to word list", "int"},
+                          {"default_weight", "default weight of word added to word list", "int"},
+                          {"fade_in_duration", "duration of video fading in, in ms", "int"},
+                          {"fade_out_duration", "duration of video fading out, in ms", "int"},
+                          {"image_change_duration", "duration of image change transition, in ms", "int"},
+                          {"view_update_mode", "repaint strategy of the output screen: minimal (default), smart, bounding or full", "string"},
+                          {"view_cache_background", "cache the background of the output screen"},
+                          {"output", "additional output window showing the same scene on screen SCREEN, full screen or with size WxH, e.g. 1:1280x720 (can be given multiple times)", "screen[:WxH]"},
+                          {"update_debounce", "wait for this time without new words before updating the word cloud, in ms (default: 0)", "int"},
+                          {"update_max_staleness", "update word cloud at the latest after this time even when debouncing, in ms (default: 2000, 0 = no limit)", "int"},
+                          {"progressive", "show a fast low resolution preview of the word cloud before the full resolution (built-in generator only)"},
+                          {"preview_budget", "time budget for the preview layout in progressive mode, in ms (default: 40)", "int"},
+                          {"cloud_cache_memory", "memory budget for rendered word clouds kept for undo, in MB (default: 256)", "int"},
+                          {"cloud_cache_disk", "disk budget for rendered word clouds kept for undo, in MB (default: 2048)", "int"},
+                          {"scrub_preview", "show preview frames in the control window while dragging the position slider, instead of seeking the video (requires ffmpeg)"},
+                          {"preroll", "number of videos kept loaded in paused players for instant start (default: 2)", "int"},
+                          {"preroll_memory", "memory budget for prerolled videos, in MB (default: 512)", "int"},
+                          {"metrics_port", "serve performance metrics in Prometheus format on this port on localhost", "int"},
+                          {"metrics_overlay", "show performance metrics on the output screen"},
+                          {"ingest_port", "accept word submissions by HTTP (POST /words) on this port on localhost", "int"},
+                          {"ingest_rate", "maximum number of submitted words per second per client, batches may contain up to 5 seconds worth of words (default: no limit)", "int"},
+                          {"ingest_max_pending", "maximum number of submitted words waiting to be added to the word list (default: 10000)", "int"},
+                          {"ingest_batch_interval", "forward submitted words in batches collected over this time, in ms (default: 250)", "int"},
+                          {"trace", "record a timeline of events, written to this file in Chrome trace format at exit and on SIGUSR1 (SIGUSR2 toggles tracing)", "file"},
+                          {"trace_buffer", "number of trace events kept per thread (default: 65536)", "int"},
+                          {"record", "append word submissions and operator actions to this session log", "file"},
+                          {"replay", "replay a session log as load test", "file"},
+                          {"replay_speed", "speed factor of the replay (default: 1, 0 = as fast as possible)", "float"},
+                          {"replay_report", "write statistics of the replay as JSON to this file", "file"},
+                          {"replay_exit", "quit when the replay has finished"},
+                          {"render_sequence", "render a timelapse of the word cloud from a session log (or a word store journal, starting from its snapshot) without showing windows, then quit", "file"},
+                          {"render_output", "directory for numbered PNG frames of render_sequence, or - for raw RGBA frames on stdout (default: -)", "file"},
+                          {"render_frames", "number of frames of render_sequence (default: one per word list change)", "int"},
+                          {"render_threads", "number of threads of render_sequence (default: number of cores)", "int"},
+                          {"font_size", "font size in control window", "int"},
+                      });
+}
+
+QSize MainWindow::readWindowSize(const QCommandLineParser &parser, QSize size)
 {
-    // Screen size.
     if (!parser.value("width").isEmpty())
     {
         const int width = parser.value("width").toUInt();
         if (width > 9 && width < 10000)
-            window_size.setWidth(width);
+            size.setWidth(width);
         else
             qWarning() << "Invalid width given:" << parser.value("width");
     }
@@ -313,50 +1082,243 @@ void MainWindow::initParameters(const QCommandLineParser &parser)
     {
         const int height = parser.value("height").toUInt();
         if (height > 9 && height < 10000)
-            window_size.setHeight(height);
+            size.setHeight(height);
         else
             qWarning() << "Invalid height given:" << parser.value("height");
     }
+    return size;
+}
+
+void MainWindow::readWordFilter(const QCommandLineParser &parser, WordFilter &filter)
+{
+    if (!parser.value("regex").isEmpty() && !filter.setPattern(parser.value("regex")))
+        qWarning() << "Invalid value for regex:" << parser.value("regex");
+    if (!parser.value("stopwords").isEmpty())
+        filter.loadStopwords(parser.value("stopwords"));
+    if (!parser.value("blocklist").isEmpty())
+        filter.loadBlocklist(parser.value("blocklist"));
+}
+
+int MainWindow::readMaxWeight(const QCommandLineParser &parser, const int max_weight)
+{
+    if (parser.value("max_weight").isEmpty())
+        return max_weight;
+    const int weight = parser.value("max_weight").toUInt();
+    if (weight > 0)
+        return weight;
+    qWarning() << "Invalid value for max_weight:" << parser.value("max_weight");
+    return max_weight;
+}
+
+int MainWindow::renderSequence(const QCommandLineParser &parser)
+{
+    const QSize size = readWindowSize(parser, {1920, 1080});
+    WordFilter filter;
+    readWordFilter(parser, filter);
+
+    SequenceRenderer renderer;
+    renderer.setFilter(&filter, readMaxWeight(parser, 100));
+    if (!parser.value("render_frames").isEmpty())
+    {
+        bool ok;
+        const int frames = parser.value("render_frames").toUInt(&ok);
+        if (ok && frames > 0)
+            renderer.setFrames(frames);
+        else
+            qWarning() << "Invalid value for render_frames:" << parser.value("render_frames");
+    }
+    if (!parser.value("render_threads").isEmpty())
+    {
+        bool ok;
+        const int threads = parser.value("render_threads").toUInt(&ok);
+        if (ok && threads > 0)
+            renderer.setThreads(threads);
+        else
+            qWarning() << "Invalid value for render_threads:" << parser.value("render_threads");
+    }
+    if (!renderer.load(parser.value("render_sequence")))
+        return 1;
+
+    // The mask is loaded once, all frames share the engine.
+    WordCloudEngine engine;
+    engine.setSize(size);
+    QString mask = parser.value("mask").isEmpty() ? QString("mask.png") : parser.value("mask");
+    if (mask.endsWith(".svg", Qt::CaseInsensitive))
+    {
+        const QString png_path = MaskRasterizer::rasterize(mask, size, QDir::tempPath());
+        if (!png_path.isEmpty())
+            mask = png_path;
+    }
+    if (!engine.loadMask(mask))
+        qWarning() << "Generating word cloud without mask.";
+    const QString output = parser.value("render_output").isEmpty() ? QString("-") : parser.value("render_output");
+    return renderer.render(engine, output) ? 0 : 1;
+}
+
+void MainWindow::initParameters(const QCommandLineParser &parser)
+{
+    // Screen size.
+    window_size = readWindowSize(parser, window_size);
+    // Tracing, as early as possible.
+    if (!parser.value("trace_buffer").isEmpty())
+    {
+        bool ok;
+        const int events = parser.value("trace_buffer").toUInt(&ok);
+        if (ok && events > 0)
+            Trace::setBufferSize(events);
+        else
+            qWarning() << "Invalid value for trace_buffer:" << parser.value("trace_buffer");
+    }
+    if (!parser.value("trace").isEmpty())
+    {
+        Trace::setOutputPath(parser.value("trace"));
+        Trace::setEnabled(true);
+    }
+
+    scene->setSceneRect(QRectF(QPointF(), window_size));
     view->setGeometry(0, 0, window_size.width(), window_size.height());
     view->show();
-    videoitem->setSize(window_size);
+    pool->setVideoSize(window_size);
+
+    // Additional outputs, given as screen index with optional size.
+    const QRegularExpression output_regex("^(\\d+)(?::(\\d+)x(\\d+))?$");
+    qint64 output_pixels = 0;
+    for (const QString &spec : parser.values("output"))
+    {
+        const QRegularExpressionMatch match = output_regex.match(spec);
+        if (!match.hasMatch())
+        {
+            qWarning() << "Invalid value for output:" << spec;
+            continue;
+        }
+        const QSize size = match.capturedRef(2).isEmpty() ? QSize() : QSize(match.capturedRef(2).toInt(), match.capturedRef(3).toInt());
+        OutputView *output = new OutputView(scene);
+        if (!output->place(match.capturedRef(1).toInt(), size))
+        {
+            delete output;
+            continue;
+        }
+        outputs.append(output);
+        output_pixels += qint64(output->width()) * output->height();
+    }
+    if (!outputs.isEmpty())
+    {
+        // The word cloud is cached at the resolution of each output, such
+        // that it is scaled only when it changes. The pixmap cache must fit
+        // one copy per output plus the one being replaced.
+        picitem->setCacheMode(QGraphicsItem::DeviceCoordinateCache);
+        QPixmapCache::setCacheLimit(qMax<qint64>(QPixmapCache::cacheLimit(), 2 * 4 * output_pixels / 1024 + 10240));
+    }
+
+    QList<QGraphicsView*> views = {view};
+    for (OutputView *output : outputs)
+        views.append(output);
+    for (QGraphicsView *output : views)
+    {
+        if (!parser.value("view_update_mode").isEmpty())
+        {
+            const QString mode = parser.value("view_update_mode");
+            if (mode == "minimal")
+                output->setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+            else if (mode == "smart")
+                output->setViewportUpdateMode(QGraphicsView::SmartViewportUpdate);
+            else if (mode == "bounding")
+                output->setViewportUpdateMode(QGraphicsView::BoundingRectViewportUpdate);
+            else if (mode == "full")
+                output->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+            else if (output == view)
+                qWarning() << "Invalid value for view_update_mode:" << mode;
+        }
+        if (parser.isSet("view_cache_background"))
+            output->setCacheMode(QGraphicsView::CacheBackground);
+    }
 
     // String valued arguments.
-    if (!parser.value("regex").isEmpty())
-        word_regex = QRegExp(parser.value("regex"));
+    readWordFilter(parser, word_filter);
     if (!parser.value("playlist").isEmpty())
         playlist_path = parser.value("playlist");
-    loadJson(playlist_path);
+    if (!parser.value("media_cache").isEmpty())
+        prober->setCacheDir(parser.value("media_cache"));
+    else
+        prober->setCacheDir("/tmp/videoswitch-media");
+    playlist->load(playlist_path);
+    prober->probe(playlist->paths());
+    seeker->setPreview(parser.isSet("scrub_preview"), prober->cacheDir());
     if (!parser.value("image").isEmpty())
         pixmap_path = parser.value("image");
+    save_image = !parser.isSet("no_image_output");
     QPixmap pixmap;
     pixmap.load(pixmap_path);
     picitem->setPixmap(pixmap);
 
-    // Arguments required for external word cloud program.
-    if (!parser.value("program").isEmpty())
-        program_path = parser.value("program");
+    // Arguments required for word cloud generation.
     if (!parser.value("mask").isEmpty())
         mask_path = parser.value("mask");
+    if (mask_path.endsWith(".svg", Qt::CaseInsensitive))
+    {
+        const QString png_path = MaskRasterizer::rasterize(mask_path, window_size, QDir::tempPath());
+        if (!png_path.isEmpty())
+            mask_path = png_path;
+    }
+    {
+        QFile mask_file(mask_path);
+        if (mask_file.open(QFile::ReadOnly))
+            mask_hash = QCryptographicHash::hash(mask_file.readAll(), QCryptographicHash::Sha1);
+    }
     if (!parser.value("wordlist").isEmpty())
         wordlist_path = parser.value("wordlist");
-    // Prepare external process for updating word cloud.
-    process->setProgram(program_path);
-    process->setArguments({
-                              "input=" + wordlist_path,
-                              "output=" + pixmap_path,
-                              "mask=" + mask_path
-                          });
-
-    // Integer valued arguments.
-    if (!parser.value("max_weight").isEmpty())
+    if (!parser.value("wordstore").isEmpty())
+        wordstore_path = parser.value("wordstore");
+    frequencies_path = wordstore_path + ".frequencies";
+    wordstore->open(wordstore_path);
+    if (wordstore->isEmpty())
+        // Initialize from plain text word list.
+        wordstore->importText(wordlist_path);
+    if (!parser.value("program").isEmpty())
     {
-        const int weight = parser.value("max_weight").toUInt();
-        if (weight > 0)
-            maxweight = weight;
+        // Prepare external process for updating word cloud.
+        use_program = true;
+        program_oneshot = parser.isSet("program_oneshot");
+        program_path = parser.value("program");
+        process->setProgram(program_path);
+        if (!parser.value("shm").isEmpty())
+            shm_path = parser.value("shm");
+        QStringList arguments = {
+            "frequencies=" + frequencies_path,
+            "output=" + (save_image ? pixmap_path : QString()),
+            "shm=" + shm_path,
+            "mask=" + mask_path
+        };
+        if (program_oneshot)
+            process->setArguments(arguments);
+        else
+        {
+            // Keep the worker running, it loads the mask only once and
+            // regenerates on request.
+            arguments.append("daemon=1");
+            process->setArguments(arguments);
+            process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            process->start();
+        }
+    }
+    else
+    {
+        // Prepare built-in word cloud engine.
+        engine.setSize(window_size);
+        if (!engine.loadMask(mask_path))
+            qWarning() << "Generating word cloud without mask.";
+    }
+    // Only generate at startup if the saved image is outdated.
+    {
+        QFile hash_file(pixmap_path + ".hash");
+        if (!pixmap.isNull() && hash_file.open(QFile::ReadOnly) && hash_file.readAll().trimmed() == contentHash())
+            qInfo() << "word cloud image is up to date";
         else
-            qWarning() << "Invalid value for max_weight:" << parser.value("max_weight");
+            requestUpdate();
     }
+
+    // Integer valued arguments.
+    maxweight = readMaxWeight(parser, maxweight);
     if (!parser.value("default_weight").isEmpty())
     {
         const int weight = parser.value("default_weight").toUInt();
@@ -392,6 +1354,165 @@ void MainWindow::initParameters(const QCommandLineParser &parser)
         else
             qWarning() << "Invalid value for image_change_duration:" << parser.value("image_change_duration");
     }
+    if (!parser.value("update_debounce").isEmpty())
+    {
+        bool ok;
+        const int duration = parser.value("update_debounce").toUInt(&ok);
+        if (ok)
+            scheduler->setDebounce(duration);
+        else
+            qWarning() << "Invalid value for update_debounce:" << parser.value("update_debounce");
+    }
+    if (!parser.value("update_max_staleness").isEmpty())
+    {
+        bool ok;
+        const int duration = parser.value("update_max_staleness").toUInt(&ok);
+        if (ok)
+            scheduler->setMaxStaleness(duration);
+        else
+            qWarning() << "Invalid value for update_max_staleness:" << parser.value("update_max_staleness");
+    }
+    if (!parser.value("preroll").isEmpty())
+    {
+        bool ok;
+        const int number = parser.value("preroll").toUInt(&ok);
+        if (ok)
+            preroll_count = number;
+        else
+            qWarning() << "Invalid value for preroll:" << parser.value("preroll");
+    }
+    pool->setCapacity(preroll_count + 1);
+    if (!parser.value("preroll_memory").isEmpty())
+    {
+        bool ok;
+        const int megabytes = parser.value("preroll_memory").toUInt(&ok);
+        if (ok)
+            pool->setMemoryBudget(qint64(megabytes)*1024*1024);
+        else
+            qWarning() << "Invalid value for preroll_memory:" << parser.value("preroll_memory");
+    }
+    prerollCandidates(-1);
+    progressive = parser.isSet("progressive");
+    if (!parser.value("preview_budget").isEmpty())
+    {
+        bool ok;
+        const int duration = parser.value("preview_budget").toUInt(&ok);
+        if (ok)
+            preview_budget = duration;
+        else
+            qWarning() << "Invalid value for preview_budget:" << parser.value("preview_budget");
+    }
+    if (!parser.value("cloud_cache_memory").isEmpty())
+    {
+        bool ok;
+        const int megabytes = parser.value("cloud_cache_memory").toUInt(&ok);
+        if (ok)
+            cloud_cache->setMemoryBudget(qint64(megabytes)*1024*1024);
+        else
+            qWarning() << "Invalid value for cloud_cache_memory:" << parser.value("cloud_cache_memory");
+    }
+    if (!parser.value("cloud_cache_disk").isEmpty())
+    {
+        bool ok;
+        const int megabytes = parser.value("cloud_cache_disk").toUInt(&ok);
+        if (ok)
+            cloud_cache->setDiskBudget(qint64(megabytes)*1024*1024);
+        else
+            qWarning() << "Invalid value for cloud_cache_disk:" << parser.value("cloud_cache_disk");
+    }
+    if (!parser.value("metrics_port").isEmpty())
+    {
+        bool ok;
+        const quint16 port = parser.value("metrics_port").toUShort(&ok);
+        if (ok && port > 0)
+        {
+            metrics_server = new MetricsServer(this);
+            metrics_server->listen(port);
+        }
+        else
+            qWarning() << "Invalid value for metrics_port:" << parser.value("metrics_port");
+    }
+    if (!parser.value("ingest_port").isEmpty())
+    {
+        bool ok;
+        const quint16 port = parser.value("ingest_port").toUShort(&ok);
+        if (ok && port > 0)
+        {
+            ingest_server = new IngestServer();
+            ingest_server->setWordFilter(word_filter);
+            ingest_server->setWeights(defaultweight, maxweight);
+            if (!parser.value("ingest_rate").isEmpty())
+            {
+                const int rate = parser.value("ingest_rate").toUInt(&ok);
+                if (ok && rate > 0)
+                    ingest_server->setRate(rate);
+                else
+                    qWarning() << "Invalid value for ingest_rate:" << parser.value("ingest_rate");
+            }
+            if (!parser.value("ingest_max_pending").isEmpty())
+            {
+                const int number = parser.value("ingest_max_pending").toUInt(&ok);
+                if (ok && number > 0)
+                    ingest_server->setMaxPending(number);
+                else
+                    qWarning() << "Invalid value for ingest_max_pending:" << parser.value("ingest_max_pending");
+            }
+            if (!parser.value("ingest_batch_interval").isEmpty())
+            {
+                const int duration = parser.value("ingest_batch_interval").toUInt(&ok);
+                if (ok)
+                    ingest_server->setBatchInterval(duration);
+                else
+                    qWarning() << "Invalid value for ingest_batch_interval:" << parser.value("ingest_batch_interval");
+            }
+            // Parsing and validation of requests is done in a separate thread.
+            ingest_thread = new QThread(this);
+            ingest_server->moveToThread(ingest_thread);
+            connect(ingest_server, &IngestServer::wordsReceived, this, &MainWindow::ingestWords);
+            ingest_thread->start();
+            QMetaObject::invokeMethod(ingest_server, "listen", Qt::QueuedConnection, Q_ARG(quint16, port));
+        }
+        else
+            qWarning() << "Invalid value for ingest_port:" << parser.value("ingest_port");
+    }
+    if (!parser.value("record").isEmpty())
+        recorder.open(parser.value("record"));
+    if (!parser.value("replay").isEmpty())
+    {
+        replayer = new SessionReplayer(this);
+        if (replayer->load(parser.value("replay")))
+        {
+            if (!parser.value("replay_speed").isEmpty())
+            {
+                bool ok;
+                const double speed = parser.value("replay_speed").toDouble(&ok);
+                if (ok && speed >= 0)
+                    replayer->setSpeed(speed);
+                else
+                    qWarning() << "Invalid value for replay_speed:" << parser.value("replay_speed");
+            }
+            replayer->setReportPath(parser.value("replay_report"));
+            replayer->setIdleCheck([this](){return scheduler->isIdle() && !image_watcher->isRunning();});
+            replay_exit = parser.isSet("replay_exit");
+            connect(replayer, &SessionReplayer::event, this, &MainWindow::applyReplayEvent);
+            connect(replayer, &SessionReplayer::finished, this, [this]()
+            {
+                if (replay_exit)
+                    QApplication::quit();
+            });
+            replayer->start();
+        }
+    }
+    if (parser.isSet("metrics_overlay"))
+    {
+        metrics_overlay = scene->addSimpleText("");
+        metrics_overlay->setBrush(Qt::white);
+        metrics_overlay->setFont(QFont("Titillium", 12));
+        metrics_overlay->setZValue(10);
+        QTimer *timer = new QTimer(this);
+        connect(timer, &QTimer::timeout, this, &MainWindow::updateMetricsOverlay);
+        timer->start(1000);
+    }
     if (!parser.value("font_size").isEmpty())
     {
         const int fontsize = parser.value("font_size").toUInt();
@@ -407,6 +1528,7 @@ void MainWindow::initParameters(const QCommandLineParser &parser)
 
 void MainWindow::playPauseVideo()
 {
+    recorder.record("pause");
     if (!videoitem->isVisible() || videoitem->opacity() < 0.1)
         return;
     if (player->state() == QMediaPlayer::PlayingState)
@@ -414,12 +1536,25 @@ void MainWindow::playPauseVideo()
     else if (player->state() == QMediaPlayer::PausedState)
     {
         player->play();
-        video_timer->start(player->duration() - player->position() - fade_out_duration);
+        scheduleFadeOut();
     }
 }
 
+void MainWindow::showVideoPosition(const qint64 pos)
+{
+    if (!slider->isSliderDown())
+        slider->setValue(pos);
+}
+
+void MainWindow::sliderReleased()
+{
+    setVideoPosition(slider->value());
+}
+
 void MainWindow::addVideoControls()
 {
+    scrub_preview->hide();
+    layout()->addWidget(scrub_preview);
     QWidget *widget = new QWidget(this);
     QHBoxLayout *hlayout = new QHBoxLayout(widget);
     QIcon icon = QIcon::fromTheme("media-playback-pause", QIcon("./pause.svg"));
@@ -432,11 +1567,16 @@ void MainWindow::addVideoControls()
 
 void MainWindow::setVideoPosition(const qint64 pos)
 {
-    player->setPosition(pos);
+    TraceSpan span("seek");
+    recorder.record("seek", {{"position", pos}});
+    seeker->seek(pos);
     if (player->state() == QMediaPlayer::PlayingState)
     {
-        if (player->duration() - pos > fade_out_duration)
-            video_timer->start(player->duration() - pos - fade_out_duration);
+        const qint64 duration = videoDuration();
+        if (duration <= 0)
+            return;
+        if (duration - pos > fade_out_duration)
+            video_timer->start(duration - pos - fade_out_duration);
         else
             fadeOut();
     }
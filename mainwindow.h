@@ -4,9 +4,8 @@
 #include <QWidget>
 #include <QGraphicsView>
 #include <QGraphicsScene>
-#include <QGraphicsVideoItem>
+#include <QGraphicsSimpleTextItem>
 #include <QMediaPlayer>
-#include <QMediaPlaylist>
 #include <QPropertyAnimation>
 #include <QParallelAnimationGroup>
 #include <QTimer>
@@ -22,6 +21,29 @@
 #include <QCommandLineParser>
 #include <QSlider>
 #include <QLabel>
+#include <QListView>
+#include <QComboBox>
+#include <QSortFilterProxyModel>
+#include <QFutureWatcher>
+#include <QThread>
+#include <functional>
+#include "wordcloudengine.h"
+#include "updatescheduler.h"
+#include "wordstore.h"
+#include "sharedimage.h"
+#include "videosurfaceitem.h"
+#include "crossfadeitem.h"
+#include "playerpool.h"
+#include "playlistmodel.h"
+#include "mediaprober.h"
+#include "cloudcache.h"
+#include "metrics.h"
+#include "ingestserver.h"
+#include "wordfilter.h"
+#include "trace.h"
+#include "sessionlog.h"
+#include "seekcontroller.h"
+#include "outputview.h"
 
 
 /// Copy of QGraphicsPixmapItem, which can be used in the Qt animation framework.
@@ -36,21 +58,31 @@ class QQGraphicsPixmapItem : public QObject, public QGraphicsPixmapItem
 class MainWindow : public QWidget
 {
     Q_OBJECT
+    /// Headless benchmarks drive the window directly.
+    friend class Benchmark;
 
     /// Standalone widget, which should be shown on large screen.
-    QGraphicsView *view;
+    OutputView *view;
+    /// Additional windows showing scene, e.g. on confidence monitors.
+    QList<OutputView*> outputs;
     /// Graphics scene for view.
     QGraphicsScene *scene;
-    /// Video shown on large screen.
-    QGraphicsVideoItem *videoitem;
-    /// Auxilliary pixmap item, only required for transition when the image changes.
-    QQGraphicsPixmapItem *picitem_fg;
+    /// Video shown on large screen (active item of pool).
+    VideoSurfaceItem *videoitem;
+    /// Transition when the image changes, only covering the changed region.
+    CrossfadeItem *crossfade;
     /// Image of the word cloud.
     QQGraphicsPixmapItem *picitem;
-    /// Media player for videoitem.
+    /// Media player for videoitem (active player of pool).
     QMediaPlayer *player;
-    /// Media playlist for videoitem.
-    QMediaPlaylist *playlist;
+    /// Pool of prerolled media players for all videos.
+    PlayerPool *pool;
+    /// Number of videos which are prerolled in paused players.
+    int preroll_count = 2;
+    /// Video marked by the operator to be played next, -1 if none.
+    int up_next = -1;
+    /// Video which is currently shown, -1 if none.
+    int playing_index = -1;
     /// Timer to fade out the video.
     QTimer* video_timer;
     /// Animation group for fading in or out the video.
@@ -61,30 +93,152 @@ class MainWindow : public QWidget
     QPropertyAnimation *audio_anim;
     /// Fade out / in the word cloud when a video starts / ends.
     QPropertyAnimation *pic_fade_anim;
-    /// Fade out picitem_fg when word cloud image changes.
+    /// Blend crossfade from old to new image when word cloud image changes.
     QPropertyAnimation *pic_change_anim;
-    /// List of push buttons for video selection.
-    QList<QPushButton*> video_buttons;
+    /// Videos of the playlist.
+    PlaylistModel *playlist;
+    /// Videos matching the text of searchedit.
+    QSortFilterProxyModel *playlist_filter;
+    /// List for video selection, only visible rows are rendered.
+    QListView *playlist_view;
+    /// Line edit to search videos by title.
+    QLineEdit *searchedit;
+    /// Metadata and thumbnails of videos.
+    MediaProber *prober;
+    /// Coalesced seeks of the active player when the slider is dragged.
+    SeekController *seeker;
     /// External process for updating the word cloud png image.
     QProcess *process;
+    /// Weighted word list from which the word cloud is generated.
+    WordStore *wordstore;
+    /// Built-in word cloud generator, used if no external program is given.
+    WordCloudEngine engine;
+    /// Current layout of the built-in engine, updated incrementally. Only
+    /// accessed by the running generation.
+    WordCloudLayout cloud_layout;
+    /// Do a full layout in the next generation of the built-in engine.
+    bool relayout_requested = false;
+    /// The running generation does a full layout.
+    bool generation_full = false;
+    /// Show a fast preview at reduced resolution before the full resolution
+    /// word cloud (built-in engine only).
+    bool progressive = false;
+    /// Resolution of the preview relative to the output.
+    qreal preview_scale = 0.25;
+    /// Time budget for the preview layout in ms.
+    int preview_budget = 40;
+    /// Layout of the preview, redone from scratch for each generation.
+    WordCloudLayout preview_layout;
+    /// Set to abort the running generation of the built-in engine.
+    QAtomicInt generation_cancel;
+    /// Watch word cloud generation of the built-in engine in a worker thread.
+    QFutureWatcher<QImage> *generator_watcher;
+    /// Watch decoding of word cloud images in a worker thread.
+    QFutureWatcher<QImage> *image_watcher;
+    /// Source of an image which arrived while another one was decoded.
+    std::function<QImage()> pending_image_source;
+    /// Cache keys of the image in image_watcher and of pending_image_source.
+    QByteArray preparing_key;
+    QByteArray pending_image_key;
+    /// Makes sure that only one word cloud generation runs at a time.
+    UpdateScheduler *scheduler;
+    /// Rendered word clouds by content hash, for undo and redo.
+    CloudCache *cloud_cache;
+    /// State of the word list for which a word cloud was generated.
+    struct HistoryState
+    {
+        /// Content hash, key in cloud_cache.
+        QByteArray key;
+        /// Words added since the previous state.
+        QVector<WordFrequency> changes;
+        /// Description shown in history_box.
+        QString label;
+    };
+    /// States which can be restored by undo, redo or history_box.
+    QVector<HistoryState> history;
+    /// Index of the current state in history.
+    int history_position = -1;
+    /// Maximum number of states in history.
+    int max_history = 100;
+    /// Words added since the last state in history.
+    QVector<WordFrequency> pending_changes;
+    /// Selection of a state from history.
+    QComboBox *history_box;
     /// Line edit to add words to the word list for the word cloud.
     QLineEdit *lineedit;
     /// Line edit to change the weight of a word added to the word cloud.
     QLineEdit *weightedit;
     /// Slider showing position in video.
     QSlider *slider;
+    /// Preview frame while the slider is dragged (with --scrub_preview).
+    QLabel *scrub_preview;
     /// Label for error messages.
     QLabel *logerr;
 
     /// Time stamp of last modification of the word cloud image.
     QDateTime last_modified;
+    /// Time since the oldest word submission which is not handled by a
+    /// generation yet.
+    QElapsedTimer submission_timer;
+    /// Time since the oldest submission handled by a generation, of which
+    /// the image is not shown yet.
+    QElapsedTimer generation_submission_timer;
+    /// Time since a video was chosen, invalid when it is playing.
+    QElapsedTimer video_start_timer;
+    /// Trace clock time when the running generation started, -1 if none.
+    qint64 trace_generation_start = -1;
+    /// Trace clock time when anim_group started, -1 if it is not running.
+    qint64 trace_anim_start = -1;
+    /// Server for performance metrics, if enabled.
+    MetricsServer *metrics_server = nullptr;
+    /// Overlay showing performance metrics on view, if enabled.
+    QGraphicsSimpleTextItem *metrics_overlay = nullptr;
+    /// Server for word submissions of the audience, if enabled. Lives in
+    /// ingest_thread.
+    IngestServer *ingest_server = nullptr;
+    QThread *ingest_thread = nullptr;
+    /// Log of word submissions and operator actions, if enabled.
+    SessionRecorder recorder;
+    /// Replay of a session log, if enabled.
+    SessionReplayer *replayer = nullptr;
+    /// Quit when the replay has finished.
+    bool replay_exit = false;
 
     QString playlist_path = "playlist.json";
     QString program_path = "gen_wordcloud.py";
     QString pixmap_path = "/tmp/wordcloud.png";
+    /// Mask image, SVG masks are rasterized at window_size.
     QString mask_path = "mask.png";
+    /// Hash of the mask image file, part of contentHash().
+    QByteArray mask_hash;
+    /// Content hash of the running generation, written to pixmap_path +
+    /// ".hash" together with the image.
+    QByteArray generation_hash;
+    /// Plain text word list, only imported if wordstore is empty.
     QString wordlist_path = "/tmp/wordlist.txt";
-    QRegExp word_regex{"\\w[\\w']+"};
+    /// Path prefix of the journal and snapshot of wordstore.
+    QString wordstore_path = "/tmp/wordstore";
+    /// Word frequencies exported for the external program.
+    QString frequencies_path = "/tmp/wordstore.frequencies";
+    /// Validation of submitted words.
+    WordFilter word_filter;
+    /// Use external program (program_path) instead of the built-in engine.
+    bool use_program = false;
+    /// Start external program for each update instead of keeping it running
+    /// as a worker which regenerates on request.
+    bool program_oneshot = false;
+    /// Sequence number of the last regeneration requested from the worker.
+    quint64 requested_seq = 0;
+    /// Sequence number of the last image shown from the worker.
+    quint64 shown_seq = 0;
+    /// Raw word cloud image shared by the external program.
+    SharedImageReader shared_image;
+    /// Shared memory file for shared_image.
+    QString shm_path = "/dev/shm/videoswitch-wordcloud";
+    /// Generation of the last image shown from shared_image.
+    quint64 shown_generation = 0;
+    /// Also write word cloud images to pixmap_path.
+    bool save_image = true;
 
     /// Video fade in durations in ms.
     int fade_in_duration = 1000;
@@ -99,15 +253,59 @@ class MainWindow : public QWidget
     /// Default weight of word added to word cloud.
     int defaultweight = 10;
 
+    /// Duration of the current video in ms: from the player if it is known
+    /// already, otherwise from prober. 0 if unknown.
+    qint64 videoDuration() const;
+    /// Hash of everything the word cloud image depends on: words, mask,
+    /// size and generator. Generation at startup is skipped if the saved
+    /// image has the same hash.
+    QByteArray contentHash() const;
+    /// Write hash of the image at image_path to image_path + ".hash".
+    static void writeContentHash(const QString &image_path, const QByteArray &hash);
+    /// Add word to wordstore and remember it for undo.
+    void addWord(const QString &word, const qreal weight);
+    /// Add words of the audience and request an update of the word cloud.
+    void addAudienceWords(const QVector<WordFrequency> &words);
+    /// Append the current state to history if the word list has changed.
+    void recordState();
+    /// Show the word cloud of the current history state, from cloud_cache
+    /// if possible.
+    void showState();
+    /// Image with key shows the current history state. Images of states which
+    /// were left by undo, redo or a jump while they were generated are only
+    /// cached.
+    bool isCurrentState(const QByteArray &key) const;
+    /// Update entries of history_box.
+    void updateHistoryBox();
+    /// Start anim_group and trace it.
+    void startAnimation();
+    /// Record the finished generation in the trace.
+    void generationCompleted();
+    /// Stop other videos and play video with index in playlist.
+    void startVideo(const int index);
+    /// Apply event of the session log which is replayed.
+    void applyReplayEvent(const QJsonObject &data);
+    /// Screen size from options width and height, size if they are not
+    /// given. Shared by the window and renderSequence().
+    static QSize readWindowSize(const QCommandLineParser &parser, QSize size);
+    /// Configure filter from options regex, stopwords and blocklist.
+    static void readWordFilter(const QCommandLineParser &parser, WordFilter &filter);
+    /// Maximum word weight from option max_weight, max_weight if it is not
+    /// given.
+    static int readMaxWeight(const QCommandLineParser &parser, const int max_weight);
+
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
-    /// Load videos for playlist.
-    void loadJson(const QString json_path);
     /// Fade in and play video.
     void play();
+    /// Add command line options for initParameters to parser.
+    static void addOptions(QCommandLineParser &parser);
     /// Initialize parameters from command line options.
     void initParameters(const QCommandLineParser &parser);
+    /// Render the word cloud timelapse of option render_sequence without
+    /// creating a window. Returns the exit status.
+    static int renderSequence(const QCommandLineParser &parser);
     void addVideoControls();
 
 public slots:
@@ -115,14 +313,75 @@ public slots:
     void videoAnimEnded();
     /// Fade out video.
     void fadeOut();
+    /// Fade out video on request of the operator.
+    void stopVideo();
+    /// Show position of the active player on slider, unless it is dragged.
+    void showVideoPosition(const qint64 pos);
+    /// Exact seek to the position of the slider after dragging.
+    void sliderReleased();
+    /// Start video_timer such that the video fades out in time, or fade out
+    /// immediately. Does nothing if the duration is not known yet.
+    void scheduleFadeOut();
     /// Add word to the word list (for generating the word cloud) from lineedit
-    /// and update the word cloud using the external process. When the process
-    /// has finished, updatePixmap is called.
+    /// and request an update of the word cloud from scheduler.
     void updateWordcloud();
-    /// Update the word cloud image (in a smooth animation).
+    /// Add words received by ingest_server to the word list and request an
+    /// update of the word cloud.
+    void ingestWords(const QVector<WordFrequency> &words);
+    /// Request an update of the word cloud from scheduler.
+    void requestUpdate();
+    /// Go back to the previous state of the word list and word cloud.
+    void undo();
+    /// Go forward to the next state of the word list and word cloud.
+    void redo();
+    /// Restore state with index position in history.
+    void jumpToState(const int position);
+    /// Request a full layout of the word cloud instead of an incremental update.
+    void relayoutWordcloud();
+    /// Generate the word cloud using the built-in engine or the external
+    /// process. When the process has finished, updatePixmap is called.
+    void startGeneration();
+    /// Show image generated by the built-in engine.
+    void generationFinished();
+    /// Show preview of the running generation, unless it was cancelled.
+    void showPreview(const QImage &image);
+    /// Update the word cloud image from pixmap_path after the external
+    /// process has finished.
     void updatePixmap(const int exitcode);
-    /// Select a video, should only be called from QPushButton events.
-    void chooseVideo();
+    /// Handle exit of the external process.
+    void processFinished(const int exitcode);
+    /// Finish the generation if the external process could not be started.
+    void processError(const QProcess::ProcessError error);
+    /// Read replies of the external word cloud worker.
+    void readProcessOutput();
+    /// Load and show word cloud image from pixmap_path.
+    void loadPixmap();
+    /// Obtain image from source in a worker thread and convert it to a
+    /// display-ready format, then show it using showPixmap().
+    /// The image is stored in cloud_cache under cache_key if that is not empty.
+    void prepareImage(const std::function<QImage()> &source, const QByteArray &cache_key = QByteArray());
+    /// Show image prepared by prepareImage().
+    void imagePrepared();
+    /// Show new image from shared_image if available. Returns false if
+    /// there is no shared image.
+    bool showSharedImage();
+    /// Show new word cloud image (in a smooth animation).
+    void showPixmap(const QPixmap &pixmap);
+    /// Play video at index of playlist_filter. With Ctrl pressed, the video
+    /// is marked to be played next instead.
+    void chooseVideo(const QModelIndex &index);
+    /// Play the first video matching the search text.
+    void chooseFirstMatch();
+    /// Make a player of the pool the active one.
+    void setActivePlayer(PlayerPool::Entry *entry);
+    /// Preroll the videos which are likely played after video index.
+    void prerollCandidates(const int index);
+    /// Mark video to be played next (or unmark it).
+    void markUpNext(const int index);
+    /// Measure time until the chosen video is playing.
+    void playerStatusChanged();
+    /// Update text of metrics_overlay.
+    void updateMetricsOverlay();
     /// Play or pause video if a video is currently visible.
     void playPauseVideo();
     /// Set video posiion and update video_timer.
@@ -0,0 +1,48 @@
+#include "maskrasterizer.h"
+#include <QSvgRenderer>
+#include <QImage>
+#include <QPainter>
+#include <QFile>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QDebug>
+
+QString MaskRasterizer::rasterize(const QString &svg_path, const QSize &size, const QString &cache_dir)
+{
+    QFile file(svg_path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not read mask:" << svg_path;
+        return QString();
+    }
+    const QByteArray svg = file.readAll();
+    const QString path = QDir(cache_dir).filePath(QString("videoswitch-mask-%1-%2x%3.png")
+            .arg(QString(QCryptographicHash::hash(svg, QCryptographicHash::Sha1).toHex()))
+            .arg(size.width()).arg(size.height()));
+    if (QFile::exists(path))
+        return path;
+
+    QSvgRenderer renderer(svg);
+    if (!renderer.isValid())
+    {
+        qWarning() << "Invalid SVG mask:" << svg_path;
+        return QString();
+    }
+    // Opaque white background, like inkscape with background opacity 255.
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    renderer.render(&painter, QRectF(QPointF(0, 0), size));
+    painter.end();
+
+    QSaveFile out(path);
+    if (!out.open(QFile::WriteOnly) || !image.save(&out, "PNG") || !out.commit())
+    {
+        qWarning() << "Could not write rasterized mask:" << path;
+        return QString();
+    }
+    qDebug() << "rasterized mask" << svg_path << "to" << path;
+    return path;
+}
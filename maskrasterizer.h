@@ -0,0 +1,19 @@
+#ifndef MASKRASTERIZER_H
+#define MASKRASTERIZER_H
+
+#include <QString>
+#include <QSize>
+
+
+/// Rasterizes SVG masks with QtSvg (replacing the inkscape call in
+/// prepare_and_run.sh). Results are cached as PNG files named by the hash
+/// of the SVG file and the resolution.
+class MaskRasterizer
+{
+public:
+    /// Return path of a PNG image of svg_path with given size, rendering it
+    /// only if it is not in cache_dir yet. Returns an empty string on error.
+    static QString rasterize(const QString &svg_path, const QSize &size, const QString &cache_dir);
+};
+
+#endif // MASKRASTERIZER_H
@@ -0,0 +1,240 @@
+#include "mediaprober.h"
+#include <QtConcurrent>
+#include <QProcess>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <algorithm>
+
+QJsonObject MediaInfo::toJson() const
+{
+    QJsonObject json = {
+        {"size", size},
+        {"mtime", mtime},
+        {"duration", duration},
+        {"width", resolution.width()},
+        {"height", resolution.height()},
+        {"codec", codec},
+        {"thumbnail", thumbnail},
+    };
+    if (keyframes_probed)
+    {
+        QJsonArray positions;
+        for (const qint64 position : keyframes)
+            positions.append(position);
+        json.insert("keyframes", positions);
+    }
+    return json;
+}
+
+MediaInfo MediaInfo::fromJson(const QJsonObject &json)
+{
+    MediaInfo info;
+    info.size = json.value("size").toVariant().toLongLong();
+    info.mtime = json.value("mtime").toVariant().toLongLong();
+    info.duration = json.value("duration").toVariant().toLongLong();
+    info.resolution = QSize(json.value("width").toInt(), json.value("height").toInt());
+    info.codec = json.value("codec").toString();
+    info.thumbnail = json.value("thumbnail").toString();
+    info.keyframes_probed = json.contains("keyframes");
+    for (const QJsonValue &position : json.value("keyframes").toArray())
+        info.keyframes.append(position.toVariant().toLongLong());
+    return info;
+}
+
+
+MediaProber::MediaProber(QObject *parent) :
+    QObject(parent),
+    save_timer(new QTimer(this))
+{
+    save_timer->setSingleShot(true);
+    save_timer->setInterval(2000);
+    connect(save_timer, &QTimer::timeout, this, &MediaProber::saveIndex);
+}
+
+MediaProber::~MediaProber()
+{
+    cancelled.storeRelease(1);
+    future.waitForFinished();
+    if (save_timer->isActive())
+        saveIndex();
+}
+
+void MediaProber::setCacheDir(const QString &path)
+{
+    cache_dir = path;
+    loadIndex();
+}
+
+void MediaProber::loadIndex()
+{
+    index.clear();
+    QFile file(QDir(cache_dir).filePath("index.json"));
+    if (!file.open(QFile::ReadOnly))
+        return;
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = json.constBegin(); it != json.constEnd(); ++it)
+        index.insert(it.key(), MediaInfo::fromJson(it->toObject()));
+    qDebug() << "loaded metadata of" << index.size() << "videos from" << cache_dir;
+}
+
+void MediaProber::saveIndex()
+{
+    save_timer->stop();
+    if (!QDir().mkpath(cache_dir))
+    {
+        qWarning() << "Could not create media cache directory" << cache_dir;
+        return;
+    }
+    QJsonObject json;
+    for (auto it = index.constBegin(); it != index.constEnd(); ++it)
+        json.insert(it.key(), it->toJson());
+    QSaveFile file(QDir(cache_dir).filePath("index.json"));
+    if (!file.open(QFile::WriteOnly)
+            || file.write(QJsonDocument(json).toJson(QJsonDocument::Compact)) < 0
+            || !file.commit())
+        qWarning() << "Could not write media cache index in" << cache_dir;
+}
+
+void MediaProber::probe(const QStringList &paths)
+{
+    cancelled.storeRelease(1);
+    future.waitForFinished();
+    cancelled.storeRelease(0);
+    QDir().mkpath(cache_dir);
+    // The worker gets a copy of the index to decide which files changed.
+    const QHash<QString, MediaInfo> known = index;
+    future = QtConcurrent::run([this, paths, known]()
+    {
+        int count = 0;
+        for (const QString &path : paths)
+        {
+            if (cancelled.loadAcquire())
+                return;
+            const QFileInfo file(path);
+            if (!file.exists())
+                continue;
+            const qint64 mtime = file.lastModified().toMSecsSinceEpoch();
+            const MediaInfo cached = known.value(path);
+            if (cached.size == file.size() && cached.mtime == mtime && cached.keyframes_probed)
+                continue;
+            const MediaInfo info = probeFile(path, file.size(), mtime);
+            // Incomplete, the file is probed again next time.
+            if (cancelled.loadAcquire())
+                return;
+            if (!info.isValid())
+            {
+                qWarning() << "Could not start ffprobe, video metadata is not available";
+                return;
+            }
+            QMetaObject::invokeMethod(this, [this, path, info](){addResult(path, info);}, Qt::QueuedConnection);
+            count++;
+        }
+        if (count > 0)
+            qDebug() << "probed" << count << "videos";
+    });
+}
+
+MediaInfo MediaProber::probeFile(const QString &path, const qint64 size, const qint64 mtime) const
+{
+    MediaInfo info;
+    info.size = size;
+    info.mtime = mtime;
+    // Also if probing fails, such that the file is not probed again at each
+    // start.
+    info.keyframes_probed = true;
+
+    QProcess process;
+    process.start("ffprobe", {"-v", "error", "-select_streams", "v:0",
+                              "-show_entries", "stream=codec_name,width,height:format=duration",
+                              "-of", "json", path});
+    if (!process.waitForStarted())
+    {
+        // Not cached, such that the file is probed when ffprobe is available.
+        info.size = -1;
+        return info;
+    }
+    if (!finish(process, 30000))
+    {
+        if (!cancelled.loadAcquire())
+            qWarning() << "Could not probe" << path << process.errorString() << process.readAllStandardError();
+        return info;
+    }
+    const QJsonObject json = QJsonDocument::fromJson(process.readAllStandardOutput()).object();
+    const QJsonObject stream = json.value("streams").toArray().first().toObject();
+    info.codec = stream.value("codec_name").toString();
+    info.resolution = QSize(stream.value("width").toInt(), stream.value("height").toInt());
+    info.duration = qRound64(1000 * json.value("format").toObject().value("duration").toString().toDouble());
+    if (info.resolution.isEmpty())
+        return info;
+
+    // Keyframe positions from the packet flags, which needs no decoding.
+    process.start("ffprobe", {"-v", "error", "-select_streams", "v:0",
+                              "-show_entries", "packet=pts_time,flags",
+                              "-of", "csv=print_section=0", path});
+    if (finish(process, 60000))
+    {
+        while (process.canReadLine())
+        {
+            const QList<QByteArray> fields = process.readLine().trimmed().split(',');
+            bool ok;
+            const double time = fields.first().toDouble(&ok);
+            if (ok && fields.length() >= 2 && fields[1].contains('K'))
+                info.keyframes.append(qRound64(1000 * time));
+        }
+        std::sort(info.keyframes.begin(), info.keyframes.end());
+    }
+    else if (cancelled.loadAcquire())
+        return info;
+    else
+        qWarning() << "Could not probe keyframes of" << path << process.readAllStandardError();
+
+    // Poster frame shortly after the start, which is usually not black.
+    const QByteArray key = path.toUtf8() + '\n' + QByteArray::number(size) + '\n' + QByteArray::number(mtime);
+    const QString thumbnail = QDir(cache_dir).filePath(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex() + ".jpg");
+    const double position = qMin(5., info.duration / 10000.);
+    process.start("ffmpeg", {"-v", "error", "-ss", QString::number(position), "-i", path,
+                             "-frames:v", "1", "-vf", QString("scale=%1:-2").arg(thumbnail_width),
+                             "-y", thumbnail});
+    if (finish(process, 30000))
+        info.thumbnail = thumbnail;
+    else if (!cancelled.loadAcquire())
+        qWarning() << "Could not create thumbnail of" << path << process.readAllStandardError();
+    return info;
+}
+
+bool MediaProber::finish(QProcess &process, const int timeout) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    // Short slices, such that cancelling does not wait for a long run.
+    while (!process.waitForFinished(100))
+    {
+        if (process.state() == QProcess::NotRunning)
+            return false;
+        if (cancelled.loadAcquire() || timer.elapsed() > timeout)
+        {
+            process.kill();
+            process.waitForFinished();
+            return false;
+        }
+    }
+    return process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+void MediaProber::addResult(const QString &path, const MediaInfo &info)
+{
+    const MediaInfo previous = index.value(path);
+    if (!previous.thumbnail.isEmpty() && previous.thumbnail != info.thumbnail)
+        QFile::remove(previous.thumbnail);
+    index.insert(path, info);
+    save_timer->start();
+    emit probed(path);
+}
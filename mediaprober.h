@@ -0,0 +1,97 @@
+#ifndef MEDIAPROBER_H
+#define MEDIAPROBER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFuture>
+#include <QAtomicInt>
+#include <QTimer>
+
+class QJsonObject;
+class QProcess;
+
+
+/// Metadata of a video file.
+struct MediaInfo
+{
+    /// File size and modification time (ms since epoch) when probed.
+    qint64 size = -1;
+    qint64 mtime = 0;
+    /// Duration in ms, 0 if unknown.
+    qint64 duration = 0;
+    /// Resolution of the first video stream.
+    QSize resolution;
+    /// Codec of the first video stream.
+    QString codec;
+    /// Path of the poster thumbnail (JPEG), empty if none.
+    QString thumbnail;
+    /// Sorted positions of keyframes in ms, for scrubbing.
+    QVector<qint64> keyframes;
+    /// Keyframes were probed (entries of older caches lack them).
+    bool keyframes_probed = false;
+
+    bool isValid() const {return size >= 0;}
+    QJsonObject toJson() const;
+    static MediaInfo fromJson(const QJsonObject &json);
+};
+
+/// Probes duration, resolution, codec, keyframes and a poster thumbnail of videos in
+/// a worker thread using ffprobe and ffmpeg. Results are stored in a cache
+/// directory (index.json and thumbnails) keyed by path, size and
+/// modification time, such that only new or changed files are probed after
+/// a restart.
+class MediaProber : public QObject
+{
+    Q_OBJECT
+
+    /// Directory containing index.json and thumbnails.
+    QString cache_dir = "/tmp/videoswitch-media";
+    /// Known metadata by path. Only accessed in the GUI thread.
+    QHash<QString, MediaInfo> index;
+    /// Running probe job.
+    QFuture<void> future;
+    /// Set to stop the probe job.
+    QAtomicInt cancelled;
+    /// Delays writing the index, such that it is not written for each file.
+    QTimer *save_timer;
+    /// Width of thumbnails in pixels.
+    int thumbnail_width = 240;
+
+    /// Run ffprobe and ffmpeg for path. Blocking, called in the worker
+    /// thread. Returns invalid info if ffprobe could not be started.
+    MediaInfo probeFile(const QString &path, const qint64 size, const qint64 mtime) const;
+    /// Wait until process has finished, killing it when timeout (in ms) is
+    /// exceeded or probing is cancelled. Returns true if it exited with code
+    /// 0.
+    bool finish(QProcess &process, const int timeout) const;
+    void loadIndex();
+
+private slots:
+    /// Store result of the worker thread.
+    void addResult(const QString &path, const MediaInfo &info);
+    /// Write index.json.
+    void saveIndex();
+
+public:
+    MediaProber(QObject *parent = nullptr);
+    /// Stops probing and writes the index.
+    ~MediaProber();
+    /// Set cache directory and load its index.
+    void setCacheDir(const QString &path);
+    QString cacheDir() const {return cache_dir;}
+    /// Probe all paths which are not in the cache or have changed, in a
+    /// worker thread. A running job is cancelled first.
+    void probe(const QStringList &paths);
+    /// Metadata of path, invalid if not probed (yet).
+    MediaInfo info(const QString &path) const {return index.value(path);}
+
+signals:
+    /// Metadata of path is available or has changed.
+    void probed(const QString &path);
+};
+
+#endif // MEDIAPROBER_H
@@ -0,0 +1,198 @@
+#include "metrics.h"
+#include <QTcpSocket>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QDebug>
+
+Histogram::Histogram() :
+    bounds({1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000}),
+    counts(bounds.length() + 1, 0)
+{
+}
+
+void Histogram::observe(const double value)
+{
+    int i = 0;
+    while (i < bounds.length() && value > bounds[i])
+        i++;
+    counts[i]++;
+    sum += value;
+    count++;
+}
+
+void Histogram::write(QString &out, const QString &name) const
+{
+    out += "# TYPE " + name + " histogram\n";
+    quint64 cumulative = 0;
+    for (int i=0; i<bounds.length(); i++)
+    {
+        cumulative += counts[i];
+        out += name + "_bucket{le=\"" + QString::number(bounds[i]) + "\"} " + QString::number(cumulative) + "\n";
+    }
+    out += name + "_bucket{le=\"+Inf\"} " + QString::number(count) + "\n";
+    out += name + "_sum " + QString::number(sum) + "\n";
+    out += name + "_count " + QString::number(count) + "\n";
+}
+
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::increment(const QString &name, const double value)
+{
+    QMutexLocker locker(&mutex);
+    counters[name] += value;
+}
+
+void Metrics::set(const QString &name, const double value)
+{
+    QMutexLocker locker(&mutex);
+    gauges[name] = value;
+}
+
+void Metrics::observe(const QString &name, const double value)
+{
+    QMutexLocker locker(&mutex);
+    histograms[name].observe(value);
+}
+
+QString Metrics::prometheusText() const
+{
+    QMutexLocker locker(&mutex);
+    QString out;
+    for (auto it = counters.constBegin(); it != counters.constEnd(); ++it)
+        out += "# TYPE videoswitch_" + it.key() + " counter\nvideoswitch_" + it.key() + " " + QString::number(it.value()) + "\n";
+    for (auto it = gauges.constBegin(); it != gauges.constEnd(); ++it)
+        out += "# TYPE videoswitch_" + it.key() + " gauge\nvideoswitch_" + it.key() + " " + QString::number(it.value()) + "\n";
+    for (auto it = histograms.constBegin(); it != histograms.constEnd(); ++it)
+        it->write(out, "videoswitch_" + it.key());
+    return out;
+}
+
+QString Metrics::summary() const
+{
+    QMutexLocker locker(&mutex);
+    QString out;
+    for (auto it = histograms.constBegin(); it != histograms.constEnd(); ++it)
+        out += it.key() + ": " + QString::number(it->mean(), 'f', 1) + " (" + QString::number(it->getCount()) + ")\n";
+    for (auto it = gauges.constBegin(); it != gauges.constEnd(); ++it)
+        out += it.key() + ": " + QString::number(it.value(), 'f', 1) + "\n";
+    for (auto it = counters.constBegin(); it != counters.constEnd(); ++it)
+        out += it.key() + ": " + QString::number(it.value()) + "\n";
+    return out.trimmed();
+}
+
+
+AnimationMonitor::AnimationMonitor(QVariantAnimation *animation, const QString &name, QObject *parent) :
+    QObject(parent),
+    name(name)
+{
+    if (QGuiApplication::primaryScreen() && QGuiApplication::primaryScreen()->refreshRate() > 1)
+        frame_interval = 1000. / QGuiApplication::primaryScreen()->refreshRate();
+    connect(animation, &QVariantAnimation::stateChanged, this, &AnimationMonitor::stateChanged);
+    connect(animation, &QVariantAnimation::valueChanged, this, &AnimationMonitor::frame);
+}
+
+void AnimationMonitor::stateChanged(QAbstractAnimation::State new_state, QAbstractAnimation::State old_state)
+{
+    if (new_state == QAbstractAnimation::Running)
+    {
+        running_timer.start();
+        frame_timer.start();
+        frames = 0;
+    }
+    else if (old_state == QAbstractAnimation::Running && running_timer.isValid())
+    {
+        const qint64 duration = running_timer.elapsed();
+        if (duration > 0)
+            Metrics::instance().set(name + "_fps", 1000. * frames / duration);
+        running_timer.invalidate();
+    }
+}
+
+void AnimationMonitor::frame()
+{
+    if (!running_timer.isValid())
+        return;
+    const qint64 interval = frame_timer.restart();
+    if (frames++ == 0)
+        return;
+    Metrics &metrics = Metrics::instance();
+    metrics.observe(name + "_frame_interval_ms", interval);
+    metrics.increment(name + "_frames_total");
+    // Every frame interval which was missed counts as a dropped frame.
+    if (interval > 1.5 * frame_interval)
+        metrics.increment(name + "_dropped_frames_total", qRound(interval / frame_interval) - 1);
+}
+
+
+StallMonitor::StallMonitor(QObject *parent) :
+    QObject(parent),
+    timer(new QTimer(this))
+{
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &StallMonitor::check);
+    timer->start(interval);
+    elapsed.start();
+}
+
+void StallMonitor::check()
+{
+    const qint64 delay = elapsed.restart() - interval;
+    if (delay > threshold)
+    {
+        Metrics::instance().observe("event_loop_stall_ms", delay);
+        Metrics::instance().increment("event_loop_stalls_total");
+    }
+}
+
+
+MetricsServer::MetricsServer(QObject *parent) :
+    QObject(parent),
+    server(new QTcpServer(this))
+{
+    connect(server, &QTcpServer::newConnection, this, &MetricsServer::newConnection);
+}
+
+bool MetricsServer::listen(const quint16 port)
+{
+    if (!server->listen(QHostAddress::LocalHost, port))
+    {
+        qWarning() << "Could not start metrics server:" << server->errorString();
+        return false;
+    }
+    qInfo() << "serving metrics on http://localhost:" + QString::number(port) + "/metrics";
+    return true;
+}
+
+void MetricsServer::newConnection()
+{
+    while (server->hasPendingConnections())
+    {
+        QTcpSocket *socket = server->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]()
+        {
+            // Wait for the complete request header.
+            if (!socket->peek(socket->bytesAvailable()).contains("\r\n\r\n"))
+                return;
+            const QList<QByteArray> request = socket->readLine().split(' ');
+            QByteArray status = "200 OK", body;
+            if (request.length() >= 2 && (request[1] == "/metrics" || request[1] == "/"))
+                body = Metrics::instance().prometheusText().toUtf8();
+            else
+            {
+                status = "404 Not Found";
+                body = "not found\n";
+            }
+            socket->write("HTTP/1.0 " + status + "\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: " + QByteArray::number(body.length()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
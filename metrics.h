@@ -0,0 +1,118 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QMutex>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QVariantAnimation>
+
+
+/// Histogram with fixed bucket bounds, exported in Prometheus format.
+class Histogram
+{
+    /// Upper bounds of the buckets.
+    QVector<double> bounds;
+    /// Number of observations in each bucket (not cumulative), the last
+    /// entry counts values above all bounds.
+    QVector<quint64> counts;
+    double sum = 0;
+    quint64 count = 0;
+
+public:
+    /// Histogram with bounds suitable for durations in ms.
+    Histogram();
+    void observe(const double value);
+    /// Append Prometheus text format lines for this histogram.
+    void write(QString &out, const QString &name) const;
+    quint64 getCount() const {return count;}
+    double mean() const {return count ? sum/count : 0.;}
+};
+
+/// Global registry of counters, gauges and histograms of performance
+/// metrics. All functions are thread safe.
+class Metrics
+{
+    mutable QMutex mutex;
+    QMap<QString, double> counters;
+    QMap<QString, double> gauges;
+    QMap<QString, Histogram> histograms;
+
+public:
+    static Metrics &instance();
+    /// Add value to counter name.
+    void increment(const QString &name, const double value = 1.);
+    /// Set gauge name.
+    void set(const QString &name, const double value);
+    /// Add observation to histogram name.
+    void observe(const QString &name, const double value);
+    /// All metrics in Prometheus text format.
+    QString prometheusText() const;
+    /// Short human readable summary (for an on-screen overlay).
+    QString summary() const;
+};
+
+/// Measure frame rate and dropped frames of an animation.
+class AnimationMonitor : public QObject
+{
+    Q_OBJECT
+
+    /// Name used in the metrics.
+    QString name;
+    /// Time since the animation started.
+    QElapsedTimer running_timer;
+    /// Time since the last frame.
+    QElapsedTimer frame_timer;
+    /// Frames in the running animation.
+    int frames = 0;
+    /// Expected time between two frames in ms.
+    double frame_interval = 1000./60;
+
+public:
+    AnimationMonitor(QVariantAnimation *animation, const QString &name, QObject *parent = nullptr);
+
+private slots:
+    void stateChanged(QAbstractAnimation::State new_state, QAbstractAnimation::State old_state);
+    void frame();
+};
+
+/// Detect stalls of the event loop using a timer which should fire
+/// regularly.
+class StallMonitor : public QObject
+{
+    Q_OBJECT
+
+    QTimer *timer;
+    QElapsedTimer elapsed;
+    /// Timer interval in ms.
+    int interval = 20;
+    /// Delays longer than this are counted as stalls, in ms.
+    int threshold = 30;
+
+public:
+    StallMonitor(QObject *parent = nullptr);
+
+private slots:
+    void check();
+};
+
+/// Minimal HTTP server on localhost, which serves the metrics in Prometheus
+/// text format.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+    QTcpServer *server;
+
+public:
+    MetricsServer(QObject *parent = nullptr);
+    bool listen(const quint16 port);
+
+private slots:
+    void newConnection();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,49 @@
+#include "outputview.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QDebug>
+
+OutputView::OutputView(QGraphicsScene *scene, QWidget *parent) :
+    QGraphicsView(scene, parent)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setStyleSheet("border: 0px");
+    setBackgroundBrush(QBrush(Qt::black));
+}
+
+void OutputView::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    // Unscaled if the window has the size of the scene.
+    if (viewport()->size() == sceneRect().size().toSize())
+        resetTransform();
+    else
+        fitInView(sceneRect(), Qt::KeepAspectRatio);
+}
+
+bool OutputView::place(const int screen, const QSize &size)
+{
+    const QList<QScreen*> screens = QGuiApplication::screens();
+    if (screen < 0 || screen >= screens.length())
+    {
+        qWarning() << "Screen" << screen << "does not exist, there are" << screens.length() << "screens";
+        return false;
+    }
+    // Scaled outputs are smoothed, the scaled images are cached per output.
+    setRenderHint(QPainter::SmoothPixmapTransform);
+    const QRect geometry = screens[screen]->geometry();
+    if (size.isEmpty())
+    {
+        setGeometry(geometry);
+        showFullScreen();
+    }
+    else
+    {
+        setWindowFlag(Qt::FramelessWindowHint);
+        setGeometry(QRect(geometry.topLeft(), size));
+        show();
+    }
+    qInfo() << "output on screen" << screen << "with size" << this->size();
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef OUTPUTVIEW_H
+#define OUTPUTVIEW_H
+
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QSize>
+
+
+/// Window showing the output scene, e.g. on the main projector or on a
+/// confidence monitor. All outputs show the same scene, so videos and word
+/// clouds are decoded and generated only once. The scene is scaled to fit
+/// the window keeping its aspect ratio.
+class OutputView : public QGraphicsView
+{
+    Q_OBJECT
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+public:
+    OutputView(QGraphicsScene *scene = nullptr, QWidget *parent = nullptr);
+    /// Show the view on screen with given size, full screen if size is
+    /// empty. Returns false if the screen does not exist.
+    bool place(const int screen, const QSize &size);
+};
+
+#endif // OUTPUTVIEW_H
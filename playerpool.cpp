@@ -0,0 +1,178 @@
+#include "playerpool.h"
+#include <QDebug>
+
+PlayerPool::PlayerPool(QGraphicsScene *scene, QMediaPlayer *player, VideoSurfaceItem *item, QObject *parent) :
+    QObject(parent),
+    scene(scene)
+{
+    active = createEntry(player, item);
+}
+
+PlayerPool::~PlayerPool()
+{
+    while (!entries.isEmpty())
+        remove(entries.last());
+}
+
+PlayerPool::Entry *PlayerPool::createEntry(QMediaPlayer *player, VideoSurfaceItem *item)
+{
+    Entry *entry = new Entry;
+    entry->player = player;
+    entry->item = item;
+    player->setVideoOutput(item->videoSurface());
+    if (item->scene() != scene)
+        scene->addItem(item);
+    item->setSize(video_size);
+    // Videos fade in over the word cloud (z value 0), independent of the
+    // order in which the items were added.
+    item->setZValue(1);
+    item->hide();
+    entries.append(entry);
+    return entry;
+}
+
+void PlayerPool::remove(Entry *entry)
+{
+    entries.removeOne(entry);
+    if (active == entry)
+        active = nullptr;
+    entry->player->stop();
+    delete entry->player;
+    scene->removeItem(entry->item);
+    delete entry->item;
+    delete entry;
+}
+
+void PlayerPool::setVideoSize(const QSize &size)
+{
+    video_size = size;
+    for (Entry *entry : entries)
+        entry->item->setSize(size);
+}
+
+void PlayerPool::setCapacity(const int number)
+{
+    capacity = qMax(1, number);
+    while (entries.length() > capacity)
+    {
+        Entry *oldest = nullptr;
+        for (Entry *entry : entries)
+            if (entry != active && (oldest == nullptr || entry->last_used < oldest->last_used))
+                oldest = entry;
+        if (oldest == nullptr)
+            break;
+        remove(oldest);
+    }
+}
+
+PlayerPool::Entry *PlayerPool::freeEntry()
+{
+    Entry *oldest = nullptr;
+    for (Entry *entry : entries)
+    {
+        if (entry == active)
+            continue;
+        if (entry->index == -1)
+            return entry;
+        if (oldest == nullptr || entry->last_used < oldest->last_used)
+            oldest = entry;
+    }
+    if (entries.length() < capacity)
+        return createEntry(new QMediaPlayer(), new VideoSurfaceItem());
+    // Only the active player is left if capacity is 1.
+    return oldest == nullptr ? active : oldest;
+}
+
+void PlayerPool::load(Entry *entry, const int index)
+{
+    entry->index = index;
+    entry->player->setMedia(QMediaContent(playlist->url(index)));
+    // Pausing a stopped player loads the media and decodes the first frame.
+    entry->player->setVolume(0);
+    entry->player->pause();
+}
+
+PlayerPool::Entry *PlayerPool::acquire(const int index)
+{
+    if (index < 0 || index >= mediaCount())
+        return nullptr;
+    Entry *entry = nullptr;
+    for (Entry *candidate : entries)
+        if (candidate->index == index)
+            entry = candidate;
+    if (entry == nullptr)
+    {
+        qDebug() << "video" << index << "was not prerolled";
+        entry = freeEntry();
+        load(entry, index);
+    }
+    if (active != nullptr && active != entry)
+    {
+        active->player->stop();
+        active->item->hide();
+    }
+    entry->last_used = ++use_counter;
+    active = entry;
+    evict();
+    return entry;
+}
+
+void PlayerPool::release()
+{
+    if (active == nullptr)
+        return;
+    active->player->stop();
+    active->item->hide();
+    if (active->index != -1)
+        active->player->pause();
+}
+
+void PlayerPool::preroll(const int index)
+{
+    if (index < 0 || index >= mediaCount() || isLoaded(index))
+        return;
+    Entry *entry = freeEntry();
+    if (entry == active)
+        return;
+    load(entry, index);
+    entry->last_used = ++use_counter;
+    evict();
+}
+
+bool PlayerPool::isLoaded(const int index) const
+{
+    for (const Entry *entry : entries)
+        if (entry->index == index)
+            return true;
+    return false;
+}
+
+qint64 PlayerPool::memoryEstimate(const Entry *entry) const
+{
+    if (entry->index == -1)
+        return 0;
+    QSize size = entry->item->nativeSize().toSize();
+    if (size.isEmpty())
+        size = video_size;
+    // A few decoded frames in 32 bit plus some decoder state.
+    return 4 * 4 * qint64(size.width()) * size.height() + 16*1024*1024;
+}
+
+void PlayerPool::evict()
+{
+    qint64 total = 0;
+    for (const Entry *entry : entries)
+        total += memoryEstimate(entry);
+    while (total > memory_budget)
+    {
+        Entry *oldest = nullptr;
+        for (Entry *entry : entries)
+            if (entry != active && entry->index != -1 && (oldest == nullptr || entry->last_used < oldest->last_used))
+                oldest = entry;
+        if (oldest == nullptr)
+            return;
+        total -= memoryEstimate(oldest);
+        qDebug() << "evicting prerolled video" << oldest->index;
+        remove(oldest);
+    }
+}
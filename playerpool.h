@@ -0,0 +1,89 @@
+#ifndef PLAYERPOOL_H
+#define PLAYERPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QUrl>
+#include <QSize>
+#include <QMediaPlayer>
+#include <QGraphicsScene>
+#include "videosurfaceitem.h"
+#include "playlistmodel.h"
+
+
+/// Pool of media players, each with its own video item. Inactive players
+/// are parked in paused state at the first frame of a video which is likely
+/// played next, such that starting it does not need to set up the decoder.
+/// Players are evicted in LRU order when the pool exceeds its capacity or
+/// memory budget.
+class PlayerPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        QMediaPlayer *player;
+        VideoSurfaceItem *item;
+        /// Index of the loaded media, -1 if none.
+        int index = -1;
+        /// Value of use_counter at last use, for LRU eviction.
+        quint64 last_used = 0;
+    };
+
+private:
+    /// Scene containing the video items.
+    QGraphicsScene *scene;
+    /// All videos which can be played, media are created when loading.
+    const PlaylistModel *playlist = nullptr;
+    /// Pooled players.
+    QList<Entry*> entries;
+    /// Currently shown player (never evicted).
+    Entry *active = nullptr;
+    /// Size of video items.
+    QSize video_size = {1920, 1080};
+    /// Maximum number of players.
+    int capacity = 3;
+    /// Maximum estimated memory of all players in bytes.
+    qint64 memory_budget = 512*1024*1024;
+    /// Counter for LRU order.
+    quint64 use_counter = 0;
+
+    /// Create new entry for given player and video item.
+    Entry *createEntry(QMediaPlayer *player, VideoSurfaceItem *item);
+    /// Entry for loading new media: unused, new or least recently used.
+    Entry *freeEntry();
+    /// Load media in entry and pause it at the first frame.
+    void load(Entry *entry, const int index);
+    /// Delete entry including player and video item.
+    void remove(Entry *entry);
+    /// Rough estimate of decoder and frame buffer memory of a player.
+    qint64 memoryEstimate(const Entry *entry) const;
+    /// Evict least recently used entries until the pool fits in the
+    /// memory budget.
+    void evict();
+
+public:
+    /// Create pool with an initial player and video item, which become
+    /// owned by the pool.
+    PlayerPool(QGraphicsScene *scene, QMediaPlayer *player, VideoSurfaceItem *item, QObject *parent = nullptr);
+    ~PlayerPool();
+    void setPlaylist(const PlaylistModel *model) {playlist = model;}
+    int mediaCount() const {return playlist == nullptr ? 0 : playlist->rowCount();}
+    void setVideoSize(const QSize &size);
+    /// Set maximum number of players (at least 1).
+    void setCapacity(const int number);
+    /// Set memory budget in bytes.
+    void setMemoryBudget(const qint64 bytes) {memory_budget = bytes; evict();}
+    /// Get player for media index, using a prerolled one if available, and
+    /// make it the active player. The previously active player is stopped.
+    Entry *acquire(const int index);
+    /// Stop active player and park it at the first frame again.
+    void release();
+    /// Load media index in a paused player, if it is not loaded yet.
+    void preroll(const int index);
+    /// Check whether media index is loaded in some player.
+    bool isLoaded(const int index) const;
+};
+
+#endif // PLAYERPOOL_H
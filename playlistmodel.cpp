@@ -0,0 +1,246 @@
+#include "playlistmodel.h"
+#include <QFile>
+#include <QFont>
+#include <QPixmap>
+#include <QPixmapCache>
+#include <QDebug>
+
+char PlaylistModel::nextToken(QIODevice &device)
+{
+    char c;
+    while (device.getChar(&c))
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            return c;
+    return 0;
+}
+
+bool PlaylistModel::readString(QIODevice &device, QString &string)
+{
+    string.clear();
+    // UTF-8 bytes which are not decoded yet.
+    QByteArray bytes;
+    char c;
+    while (device.getChar(&c))
+    {
+        if (c == '"')
+        {
+            string += QString::fromUtf8(bytes);
+            return true;
+        }
+        if (c != '\\')
+        {
+            bytes.append(c);
+            continue;
+        }
+        if (!device.getChar(&c))
+            return false;
+        switch (c)
+        {
+        case 'b': bytes.append('\b'); break;
+        case 'f': bytes.append('\f'); break;
+        case 'n': bytes.append('\n'); break;
+        case 'r': bytes.append('\r'); break;
+        case 't': bytes.append('\t'); break;
+        case 'u':
+        {
+            char hex[4];
+            if (device.read(hex, 4) != 4)
+                return false;
+            bool ok;
+            const ushort code = QByteArray(hex, 4).toUShort(&ok, 16);
+            if (!ok)
+                return false;
+            // Surrogate pairs are appended as two UTF-16 code units.
+            string += QString::fromUtf8(bytes);
+            bytes.clear();
+            string += QChar(code);
+            break;
+        }
+        default:
+            bytes.append(c);
+        }
+    }
+    return false;
+}
+
+bool PlaylistModel::skipValue(QIODevice &device, char c)
+{
+    int depth = 0;
+    QString ignored;
+    while (true)
+    {
+        if (c == '"')
+        {
+            if (!readString(device, ignored))
+                return false;
+        }
+        else if (c == '{' || c == '[')
+            depth++;
+        else if (c == '}' || c == ']')
+            depth--;
+        if (!device.getChar(&c))
+            return false;
+        if (depth == 0 && (c == ',' || c == '}'))
+        {
+            // Leave the separator for the caller.
+            device.ungetChar(c);
+            return true;
+        }
+    }
+}
+
+bool PlaylistModel::load(const QString &path)
+{
+    beginResetModel();
+    entries.clear();
+    rows_by_path.clear();
+    up_next = -1;
+    endResetModel();
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qWarning() << "File not found:" << path;
+        return false;
+    }
+    if (nextToken(file) != '{')
+    {
+        qWarning() << "Playlist must be a JSON object:" << path;
+        return false;
+    }
+
+    QVector<Entry> chunk;
+    const auto flush = [this, &chunk]()
+    {
+        if (chunk.isEmpty())
+            return;
+        beginInsertRows(QModelIndex(), entries.length(), entries.length() + chunk.length() - 1);
+        for (int i=0; i<chunk.length(); i++)
+            rows_by_path.insert(chunk[i].path, entries.length() + i);
+        entries.append(chunk);
+        endInsertRows();
+        chunk.clear();
+    };
+    bool ok = true;
+    char c = nextToken(file);
+    while (ok && c == '"')
+    {
+        Entry entry;
+        ok = readString(file, entry.title) && nextToken(file) == ':';
+        if (!ok)
+            break;
+        c = nextToken(file);
+        if (c == '"')
+        {
+            ok = readString(file, entry.path);
+            if (ok)
+                chunk.append(entry);
+        }
+        else
+        {
+            qWarning() << "Ignoring playlist entry without path:" << entry.title;
+            ok = skipValue(file, c);
+        }
+        if (chunk.length() >= 256)
+            flush();
+        c = nextToken(file);
+        if (c == ',')
+            c = nextToken(file);
+    }
+    flush();
+    if (!ok || c != '}')
+        qWarning() << "Error parsing playlist" << path << "after" << entries.length() << "entries";
+    qDebug() << "loaded" << entries.length() << "videos from" << path;
+    return true;
+}
+
+int PlaylistModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : entries.length();
+}
+
+QVariant PlaylistModel::data(const QModelIndex &index, const int role) const
+{
+    if (!index.isValid() || index.row() >= entries.length())
+        return QVariant();
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        return entries[index.row()].title;
+    case PathRole:
+        return entries[index.row()].path;
+    case Qt::ToolTipRole:
+    {
+        QString tooltip = entries[index.row()].path;
+        const MediaInfo info = prober == nullptr ? MediaInfo() : prober->info(entries[index.row()].path);
+        if (info.duration > 0)
+            tooltip += QString("\n%1:%2, %3x%4, %5")
+                    .arg(info.duration / 60000).arg(info.duration / 1000 % 60, 2, 10, QChar('0'))
+                    .arg(info.resolution.width()).arg(info.resolution.height()).arg(info.codec);
+        return tooltip;
+    }
+    case Qt::DecorationRole:
+    {
+        if (prober == nullptr)
+            break;
+        const QString thumbnail = prober->info(entries[index.row()].path).thumbnail;
+        if (thumbnail.isEmpty())
+            break;
+        // Thumbnails are small, decoding them on demand is cheap.
+        QPixmap pixmap;
+        if (!QPixmapCache::find(thumbnail, &pixmap) && pixmap.load(thumbnail))
+            QPixmapCache::insert(thumbnail, pixmap);
+        return pixmap;
+    }
+    case Qt::FontRole:
+        if (index.row() == up_next)
+        {
+            QFont font;
+            font.setItalic(true);
+            return font;
+        }
+        break;
+    }
+    return QVariant();
+}
+
+void PlaylistModel::setProber(const MediaProber *media_prober)
+{
+    if (prober != nullptr)
+        disconnect(prober, nullptr, this, nullptr);
+    prober = media_prober;
+    if (prober != nullptr)
+        connect(prober, &MediaProber::probed, this, &PlaylistModel::mediaProbed);
+}
+
+QStringList PlaylistModel::paths() const
+{
+    QStringList list;
+    list.reserve(entries.length());
+    for (const Entry &entry : entries)
+        list.append(entry.path);
+    return list;
+}
+
+void PlaylistModel::mediaProbed(const QString &path)
+{
+    for (auto it = rows_by_path.constFind(path); it != rows_by_path.constEnd() && it.key() == path; ++it)
+        emit dataChanged(index(it.value()), index(it.value()), {Qt::DecorationRole, Qt::ToolTipRole});
+}
+
+QHash<int, QByteArray> PlaylistModel::roleNames() const
+{
+    QHash<int, QByteArray> names = QAbstractListModel::roleNames();
+    names.insert(PathRole, "path");
+    return names;
+}
+
+void PlaylistModel::setUpNext(const int row)
+{
+    const int previous = up_next;
+    up_next = row;
+    if (previous >= 0 && previous < entries.length())
+        emit dataChanged(index(previous), index(previous), {Qt::FontRole});
+    if (row >= 0 && row < entries.length())
+        emit dataChanged(index(row), index(row), {Qt::FontRole});
+}
@@ -0,0 +1,76 @@
+#ifndef PLAYLISTMODEL_H
+#define PLAYLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include <QString>
+#include <QUrl>
+#include <QMultiHash>
+#include "mediaprober.h"
+
+class QIODevice;
+
+
+/// Videos of the playlist. The playlist json file is a single object
+/// mapping titles to video file paths. It is parsed in a streaming way
+/// (without building a QJsonDocument) and entries keep the order of the
+/// file. Media are only created by PlayerPool when a video is loaded.
+class PlaylistModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    struct Entry
+    {
+        QString title;
+        QString path;
+    };
+
+    QVector<Entry> entries;
+    /// Rows by path, for updates of metadata.
+    QMultiHash<QString, int> rows_by_path;
+    /// Source of metadata and thumbnails, may be null.
+    const MediaProber *prober = nullptr;
+    /// Row of the video marked to be played next, -1 if none.
+    int up_next = -1;
+
+    /// Streaming parser state: skip whitespace and return next character,
+    /// 0 at the end.
+    static char nextToken(QIODevice &device);
+    /// Read JSON string after the opening quote. Returns false on error.
+    static bool readString(QIODevice &device, QString &string);
+    /// Skip a JSON value which is not a string, c is its first character.
+    static bool skipValue(QIODevice &device, char c);
+
+public:
+    enum Roles
+    {
+        PathRole = Qt::UserRole,
+    };
+
+    PlaylistModel(QObject *parent = nullptr) : QAbstractListModel(parent) {}
+    /// Replace entries by the content of playlist file. Rows are inserted in
+    /// chunks while parsing. Returns false if the file could not be read.
+    bool load(const QString &path);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, const int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    /// Show metadata and thumbnails from prober.
+    void setProber(const MediaProber *media_prober);
+
+    QString title(const int row) const {return entries[row].title;}
+    QString path(const int row) const {return entries[row].path;}
+    /// Paths of all entries.
+    QStringList paths() const;
+    /// Media url of row, created on demand.
+    QUrl url(const int row) const {return QUrl::fromLocalFile(entries[row].path);}
+    /// Mark row as video which is played next (shown in italics), -1 for none.
+    void setUpNext(const int row);
+
+private slots:
+    /// Metadata of path became available.
+    void mediaProbed(const QString &path);
+};
+
+#endif // PLAYLISTMODEL_H
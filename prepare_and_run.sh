@@ -11,9 +11,8 @@ Options required for preparation must be set as environment variables:
     WORDLIST_SOURCE = "wordlist_init.txt"
     WORDLIST = "/tmp/wordlist.txt"
     PICTURE = "/tmp/wordcloud.png"
-    MASK_SOURCE = "mask.svg"
-    MASK = "/tmp/mask.png"
-    PROGRAM = "gen_wordcloud.py"
+    MASK_SOURCE = "mask.svg"  (rasterized by videoswitch)
+    PROGRAM = ""  (e.g. "gen_wordcloud.py", default: built-in generator)
 
 Other options are passed directly to videoswitch:
   --playlist <file>              playist json file path
@@ -35,12 +34,15 @@ set -ex
 : ${WORDLIST:="/tmp/wordlist.txt"}
 : ${PICTURE:="/tmp/wordcloud.png"}
 : ${MASK_SOURCE:="mask.svg"}
-: ${MASK:="/tmp/mask.png"}
-: ${PROGRAM:="gen_wordcloud.py"}
+: ${PROGRAM:=""}
 
 
+# The mask is rasterized and the word cloud is generated by videoswitch,
+# which skips both if nothing has changed since the last run.
 [ -e "$WORDLIST" ] || cp "$WORDLIST_SOURCE" "$WORDLIST"
-inkscape -o "$MASK" -w "$WIDTH" -h "$HEIGHT" -y 255 "$MASK_SOURCE" \
-    || inkscape --export-png="$MASK" -w "$WIDTH" -h "$HEIGHT" -y 255 "$MASK_SOURCE" # old syntax
-python3 "$PROGRAM" mask="$MASK" input="$WORDLIST" output="$PICTURE"
-./videoswitch -W "$WIDTH" -H "$HEIGHT" --mask "$MASK" --wordlist "$WORDLIST" --image "$PICTURE" --program "$PROGRAM" $@
+if [ -n "$PROGRAM" ]
+then
+    ./videoswitch -W "$WIDTH" -H "$HEIGHT" --mask "$MASK_SOURCE" --wordlist "$WORDLIST" --image "$PICTURE" --program "$PROGRAM" $@
+else
+    ./videoswitch -W "$WIDTH" -H "$HEIGHT" --mask "$MASK_SOURCE" --wordlist "$WORDLIST" --image "$PICTURE" $@
+fi
@@ -0,0 +1,197 @@
+#include "seekcontroller.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <algorithm>
+#include "metrics.h"
+#include "trace.h"
+
+SeekController::SeekController(QObject *parent) :
+    QObject(parent),
+    seek_timeout(new QTimer(this)),
+    extractor(new QProcess(this)),
+    previews(32*1024)
+{
+    // The player usually reports the new position earlier, this only limits
+    // how long a seek blocks the next one if it does not.
+    seek_timeout->setSingleShot(true);
+    seek_timeout->setInterval(150);
+    connect(seek_timeout, &QTimer::timeout, this, &SeekController::seekDone);
+    connect(extractor, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &SeekController::previewExtracted);
+    connect(extractor, &QProcess::errorOccurred, this, &SeekController::extractorError);
+}
+
+void SeekController::setPlayer(QMediaPlayer *new_player)
+{
+    if (player != nullptr)
+        disconnect(player, nullptr, this, nullptr);
+    player = new_player;
+    if (player != nullptr)
+        connect(player, &QMediaPlayer::positionChanged, this, &SeekController::seekDone);
+    pending = -1;
+    in_flight = false;
+    seek_timeout->stop();
+}
+
+void SeekController::setMedia(const QString &path, const QVector<qint64> &keyframe_positions)
+{
+    if (path != media_path)
+    {
+        previews.clear();
+        preview_pending = -1;
+        preview_wanted = -1;
+    }
+    media_path = path;
+    keyframes = keyframe_positions;
+}
+
+void SeekController::setPreview(const bool enable, const QString &cache_dir)
+{
+    preview = enable;
+    preview_dir = QDir(cache_dir).filePath("previews");
+    if (preview && !QDir().mkpath(preview_dir))
+        qWarning() << "Could not create preview directory" << preview_dir;
+}
+
+qint64 SeekController::nearestKeyframe(const qint64 position) const
+{
+    if (keyframes.isEmpty())
+        return position;
+    const auto next = std::lower_bound(keyframes.constBegin(), keyframes.constEnd(), position);
+    if (next == keyframes.constBegin())
+        return *next;
+    if (next == keyframes.constEnd() || position - *(next - 1) <= *next - position)
+        return *(next - 1);
+    return *next;
+}
+
+void SeekController::scrub(const qint64 position)
+{
+    const qint64 target = nearestKeyframe(position);
+    if (preview)
+    {
+        showPreview(target);
+        return;
+    }
+    if (pending >= 0)
+        Metrics::instance().increment("seeks_coalesced_total");
+    pending = target;
+    issue();
+}
+
+void SeekController::seek(const qint64 position)
+{
+    if (preview_wanted >= 0)
+    {
+        preview_wanted = -1;
+        preview_pending = -1;
+        emit previewChanged(QImage());
+    }
+    if (pending >= 0)
+        Metrics::instance().increment("seeks_coalesced_total");
+    pending = position;
+    issue();
+}
+
+void SeekController::issue()
+{
+    if (in_flight || pending < 0 || player == nullptr)
+        return;
+    Trace::instant("seek_issued");
+    Metrics::instance().increment("seeks_total");
+    player->setPosition(pending);
+    pending = -1;
+    in_flight = true;
+    seek_timeout->start();
+}
+
+void SeekController::seekDone()
+{
+    if (!in_flight)
+        return;
+    seek_timeout->stop();
+    in_flight = false;
+    issue();
+}
+
+QString SeekController::previewPath(const qint64 position) const
+{
+    const QFileInfo file(media_path);
+    const QByteArray key = media_path.toUtf8() + '\n' + QByteArray::number(file.size()) + '\n'
+            + QByteArray::number(file.lastModified().toMSecsSinceEpoch());
+    return QDir(preview_dir).filePath(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()
+                                      + "-" + QString::number(position) + ".jpg");
+}
+
+void SeekController::showPreview(const qint64 position)
+{
+    if (media_path.isEmpty() || position == preview_wanted)
+        return;
+    preview_wanted = position;
+    if (previews.contains(position))
+    {
+        emit previewChanged(*previews.object(position));
+        return;
+    }
+    const QString path = previewPath(position);
+    if (QFileInfo::exists(path))
+    {
+        QImage *image = new QImage(path);
+        if (!image->isNull())
+        {
+            emit previewChanged(*image);
+            previews.insert(position, image, qMax(1, int(image->sizeInBytes() / 1024)));
+            return;
+        }
+        delete image;
+    }
+    preview_pending = position;
+    extractPreview();
+}
+
+void SeekController::extractPreview()
+{
+    if (extracting >= 0 || preview_pending < 0)
+        return;
+    extracting = preview_pending;
+    extracting_path = previewPath(extracting);
+    preview_pending = -1;
+    // Input seeking jumps to the keyframe at (or before) the position.
+    extractor->start("ffmpeg", {"-v", "error", "-ss", QString::number(extracting / 1000., 'f', 3), "-i", media_path,
+                                "-frames:v", "1", "-vf", QString("scale=%1:-2").arg(preview_width),
+                                "-y", extracting_path});
+}
+
+void SeekController::extractorError(const QProcess::ProcessError error)
+{
+    // Other errors are followed by finished().
+    if (error != QProcess::FailedToStart)
+        return;
+    qWarning() << "Could not start ffmpeg, seek previews are disabled";
+    extracting = -1;
+    preview_pending = -1;
+    preview = false;
+}
+
+void SeekController::previewExtracted(const int exitcode)
+{
+    const qint64 position = extracting;
+    extracting = -1;
+    if (exitcode != 0)
+        qWarning() << "Could not extract preview of" << media_path << "at" << position << extractor->readAllStandardError();
+    // If the video changed meanwhile, the file only stays cached on disk.
+    else if (extracting_path == previewPath(position))
+    {
+        QImage *image = new QImage(extracting_path);
+        if (image->isNull())
+            delete image;
+        else
+        {
+            if (position == preview_wanted)
+                emit previewChanged(*image);
+            previews.insert(position, image, qMax(1, int(image->sizeInBytes() / 1024)));
+        }
+    }
+    extractPreview();
+}
@@ -0,0 +1,91 @@
+#ifndef SEEKCONTROLLER_H
+#define SEEKCONTROLLER_H
+
+#include <QObject>
+#include <QVector>
+#include <QString>
+#include <QImage>
+#include <QCache>
+#include <QTimer>
+#include <QProcess>
+#include <QMediaPlayer>
+
+
+/// Seeks of the active player while the operator drags the position slider.
+/// At most one seek is in flight, newer positions replace a pending one.
+/// During a drag, positions snap to the nearest keyframe, which the decoder
+/// reaches without decoding frames in between. Releasing the slider seeks
+/// exactly. Optionally, dragging does not seek the player at all but shows
+/// preview frames (extracted with ffmpeg and cached) in the control window.
+class SeekController : public QObject
+{
+    Q_OBJECT
+
+    QMediaPlayer *player = nullptr;
+    /// Video of player.
+    QString media_path;
+    /// Sorted keyframe positions of the video in ms, may be empty.
+    QVector<qint64> keyframes;
+    /// A seek was issued and the player has not reported a position since.
+    bool in_flight = false;
+    /// Position of the next seek in ms, -1 if none.
+    qint64 pending = -1;
+    /// Ends the in flight state if the player does not report a position.
+    QTimer *seek_timeout;
+
+    /// Show previews instead of seeking during drags.
+    bool preview = false;
+    /// Directory for extracted preview frames.
+    QString preview_dir;
+    int preview_width = 320;
+    /// Extracts one preview frame at a time.
+    QProcess *extractor;
+    /// Position being extracted, -1 if none.
+    qint64 extracting = -1;
+    /// Preview file being extracted.
+    QString extracting_path;
+    /// Position of the next preview to extract, -1 if none.
+    qint64 preview_pending = -1;
+    /// Position of the preview which should be shown, -1 if none.
+    qint64 preview_wanted = -1;
+    /// Decoded previews of the current video by position.
+    QCache<qint64, QImage> previews;
+
+    /// Keyframe closest to position, position itself if keyframes are
+    /// unknown.
+    qint64 nearestKeyframe(const qint64 position) const;
+    /// Seek to pending position unless a seek is in flight.
+    void issue();
+    /// Preview file of position of the current video.
+    QString previewPath(const qint64 position) const;
+    /// Show preview of position, extracting it if necessary.
+    void showPreview(const qint64 position);
+    /// Start extracting preview_pending unless an extraction is running.
+    void extractPreview();
+
+private slots:
+    void seekDone();
+    void previewExtracted(const int exitcode);
+    /// Disable previews if ffmpeg could not be started.
+    void extractorError(const QProcess::ProcessError error);
+
+public:
+    SeekController(QObject *parent = nullptr);
+    /// Set player which is seeked. Pending seeks are dropped.
+    void setPlayer(QMediaPlayer *new_player);
+    /// Set video of the player and its keyframes.
+    void setMedia(const QString &path, const QVector<qint64> &keyframe_positions);
+    /// Show preview frames instead of seeking during drags.
+    void setPreview(const bool enable, const QString &cache_dir);
+    bool previewEnabled() const {return preview;}
+    /// Position while dragging the slider.
+    void scrub(const qint64 position);
+    /// Exact seek, e.g. when the slider is released. Hides the preview.
+    void seek(const qint64 position);
+
+signals:
+    /// Preview frame for position should be shown, null image to hide it.
+    void previewChanged(const QImage &image);
+};
+
+#endif // SEEKCONTROLLER_H
@@ -0,0 +1,255 @@
+#include "sequencerenderer.h"
+#include "wordstore.h"
+#include <QFile>
+#include <QDir>
+#include <QHash>
+#include <QQueue>
+#include <QBuffer>
+#include <QThread>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstdio>
+
+SequenceRenderer::SequenceRenderer() :
+    threads(QThread::idealThreadCount())
+{
+}
+
+bool SequenceRenderer::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not read word list history" << path;
+        return false;
+    }
+    QByteArray first;
+    while (!file.atEnd() && first.isEmpty())
+        first = file.readLine().trimmed();
+    file.close();
+    initial.clear();
+    steps.clear();
+    const bool ok = first.startsWith('{') ? loadSessionLog(path) : loadJournal(path);
+    if (ok)
+        qInfo() << "loaded" << steps.length() << "word list changes from" << path;
+    return ok;
+}
+
+bool SequenceRenderer::loadSessionLog(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+    bool history_warned = false;
+    while (!file.atEnd())
+    {
+        const QJsonObject data = QJsonDocument::fromJson(file.readLine()).object();
+        const QString type = data.value("type").toString();
+        if (type == "words" || type == "history")
+        {
+            // Audience words were filtered before they were recorded, undo
+            // and redo are recorded as changes of the word list.
+            const QJsonValue changes = data.value(type == "words" ? "words" : "changes");
+            if (changes.isUndefined())
+            {
+                if (!history_warned)
+                    qWarning() << "Session log" << path << "lacks changes of undo and redo, they are not shown";
+                history_warned = true;
+                continue;
+            }
+            for (const QJsonValue &item : changes.toArray())
+            {
+                const QJsonArray pair = item.toArray();
+                steps.append({pair.at(0).toString(), pair.at(1).toDouble()});
+            }
+        }
+        else if (type == "word")
+        {
+            const QString word = data.value("word").toString();
+            bool ok;
+            const int weight = data.value("weight").toString().toUInt(&ok);
+            if (word.isEmpty() || !ok || (filter != nullptr && filter->check(word) != WordFilter::Accepted))
+                continue;
+            steps.append({word, qMin(weight, max_weight)});
+        }
+    }
+    if (steps.isEmpty())
+    {
+        qWarning() << "Session log" << path << "contains no words";
+        return false;
+    }
+    return true;
+}
+
+bool SequenceRenderer::loadJournal(const QString &path)
+{
+    if (path.endsWith(".journal"))
+    {
+        // The journal was truncated when the snapshot was written, the
+        // snapshot is the state at its start.
+        const QString snapshot_path = path.left(path.length() - 8) + ".snapshot";
+        const int generation = WordStore::readGeneration(path);
+        const int snapshot_generation = WordStore::readGeneration(snapshot_path);
+        if (snapshot_generation > generation)
+        {
+            qWarning() << "Word journal" << path << "is older than snapshot" << snapshot_path;
+            return false;
+        }
+        if (QFile::exists(snapshot_path))
+        {
+            readEntries(snapshot_path, initial);
+            qInfo() << "starting from" << initial.length() << "words in" << snapshot_path;
+        }
+    }
+    readEntries(path, steps);
+    if (steps.isEmpty())
+    {
+        qWarning() << "Word list history" << path << "is empty";
+        return false;
+    }
+    return true;
+}
+
+void SequenceRenderer::readEntries(const QString &path, QVector<WordFrequency> &words)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return;
+    while (!file.atEnd())
+    {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.startsWith('#'))
+            continue;
+        const int tab = line.lastIndexOf('\t');
+        bool ok = false;
+        const qreal weight = tab > 0 ? line.midRef(tab + 1).toDouble(&ok) : 0;
+        if (ok)
+            words.append({line.left(tab), weight});
+        else if (!line.isEmpty())
+            qWarning() << "Ignoring invalid line in" << path << ":" << line;
+    }
+}
+
+QByteArray SequenceRenderer::renderFrame(const WordCloudEngine &engine, const QVector<WordFrequency> &frequencies, const bool raw)
+{
+    const QImage image = engine.generate(frequencies);
+    if (raw)
+    {
+        // 32 bit rows are never padded, the image is one contiguous block.
+        const QImage rgba = image.convertToFormat(QImage::Format_RGBA8888);
+        return QByteArray(reinterpret_cast<const char*>(rgba.constBits()), int(rgba.sizeInBytes()));
+    }
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QBuffer::WriteOnly);
+    if (!image.save(&buffer, "PNG"))
+        return QByteArray();
+    return png;
+}
+
+bool SequenceRenderer::render(const WordCloudEngine &engine, const QString &output)
+{
+    const bool raw = output == "-";
+    QFile stream;
+    if (raw)
+    {
+        if (!stream.open(stdout, QFile::WriteOnly))
+        {
+            qWarning() << "Could not open stdout for writing";
+            return false;
+        }
+    }
+    else if (!QDir().mkpath(output))
+    {
+        qWarning() << "Could not create output directory" << output;
+        return false;
+    }
+    const int count = frames > 0 ? qMin(frames, steps.length()) : steps.length();
+    const QSize size = engine.outputSize();
+    qInfo().noquote() << "rendering" << count << "frames of" << QString("%1x%2").arg(size.width()).arg(size.height())
+                      << "with" << threads << "threads to" << (raw ? QString("stdout (raw RGBA)") : output);
+
+    // The engine is only read by the jobs, they share its mask. Word states
+    // are built here in order and handed to the jobs by value. At most
+    // two frames per thread are in flight, which keeps all threads busy
+    // while bounding the memory of finished frames waiting to be written.
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QQueue<QFuture<QByteArray>> running;
+    // Words in order of first insertion, such that words of equal weight
+    // are placed in the same order in all frames. Removed words are kept
+    // with weight 0 and skipped when taking the state.
+    QVector<WordFrequency> entries;
+    QHash<QString, int> positions;
+    // Same merging of case variants as in WordStore.
+    const auto apply = [&entries, &positions](const WordFrequency &change)
+    {
+        const QString key = change.first.toLower();
+        auto position = positions.constFind(key);
+        if (position == positions.constEnd())
+        {
+            position = positions.insert(key, entries.length());
+            entries.append({change.first, 0});
+        }
+        WordFrequency &entry = entries[*position];
+        if (entry.second <= 0)
+            // Spelling of a word which is added again.
+            entry.first = change.first;
+        entry.second += change.second;
+        if (entry.second <= 1e-9)
+            entry.second = 0;
+    };
+    for (const WordFrequency &change : initial)
+        apply(change);
+    int applied = 0;
+    int queued = 0;
+    int written = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (written < count)
+    {
+        while (queued < count && running.length() < 2 * threads)
+        {
+            const int end = int(qint64(queued + 1) * steps.length() / count);
+            for (; applied < end; applied++)
+                apply(steps[applied]);
+            QVector<WordFrequency> state;
+            state.reserve(entries.length());
+            for (const WordFrequency &entry : entries)
+                if (entry.second > 0)
+                    state.append(entry);
+            running.enqueue(QtConcurrent::run(&pool, [&engine, state, raw]()
+            {
+                return renderFrame(engine, state, raw);
+            }));
+            queued++;
+        }
+        const QByteArray data = running.dequeue().result();
+        written++;
+        bool ok = !data.isEmpty();
+        if (ok && raw)
+            ok = stream.write(data) == data.size() && stream.flush();
+        else if (ok)
+        {
+            QFile file(QDir(output).filePath(QString("frame_%1.png").arg(written, 5, 10, QChar('0'))));
+            ok = file.open(QFile::WriteOnly) && file.write(data) == data.size();
+        }
+        if (!ok)
+        {
+            qWarning() << "Could not write frame" << written;
+            // Let the remaining jobs finish, they reference the engine.
+            pool.clear();
+            pool.waitForDone();
+            return false;
+        }
+        if (written % qMax(1, count / 10) == 0 || written == count)
+            qInfo().noquote() << "frame" << written << "of" << count
+                              << QString("(%1 frames/s)").arg(written * 1000. / qMax<qint64>(1, timer.elapsed()), 0, 'f', 1);
+    }
+    return true;
+}
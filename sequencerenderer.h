@@ -0,0 +1,60 @@
+#ifndef SEQUENCERENDERER_H
+#define SEQUENCERENDERER_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include "wordcloudengine.h"
+#include "wordfilter.h"
+
+
+/// Offline rendering of a word cloud timelapse from a recorded word list
+/// history. The history is either a session log (see SessionRecorder) or a
+/// word store journal. A journal only contains the changes since the last
+/// compaction, it starts from the state in the snapshot next to it. The
+/// frames are laid out in parallel on a thread pool, all jobs share one
+/// engine and therefore the loaded mask. Frames are written in order, as
+/// numbered PNG files or as raw RGBA video stream.
+class SequenceRenderer
+{
+    /// Word list before the first step.
+    QVector<WordFrequency> initial;
+    /// Changes of the word list in order of the history.
+    QVector<WordFrequency> steps;
+    /// Number of frames, 0 for one frame per step.
+    int frames = 0;
+    /// Number of worker threads.
+    int threads;
+    /// Filter for words entered by the operator in session logs.
+    const WordFilter *filter = nullptr;
+    /// Maximum weight of words entered by the operator in session logs.
+    int max_weight = 100;
+
+    /// Read session log, returns false if it contains no word changes.
+    bool loadSessionLog(const QString &path);
+    /// Read word store journal and the snapshot it applies to.
+    bool loadJournal(const QString &path);
+    /// Read lines of journal / snapshot format into words.
+    static void readEntries(const QString &path, QVector<WordFrequency> &words);
+    /// Lay out word cloud and encode it as PNG, or as raw RGBA if raw is
+    /// set. Returns an empty array on error.
+    static QByteArray renderFrame(const WordCloudEngine &engine, const QVector<WordFrequency> &frequencies, const bool raw);
+
+public:
+    SequenceRenderer();
+    /// Load history. Returns false if it could not be read.
+    bool load(const QString &path);
+    int stepCount() const {return steps.length();}
+    /// Number of frames, which are evenly spread over the history (default:
+    /// one frame per step).
+    void setFrames(const int count) {frames = count;}
+    void setThreads(const int count) {threads = qMax(1, count);}
+    /// Apply filter and maximum weight to operator input in session logs, as
+    /// in the live show.
+    void setFilter(const WordFilter *word_filter, const int max) {filter = word_filter; max_weight = max;}
+    /// Render all frames to directory output (frame_00001.png, ...) or, if
+    /// output is "-", as raw RGBA frames to stdout. Returns false on error.
+    bool render(const WordCloudEngine &engine, const QString &output);
+};
+
+#endif // SEQUENCERENDERER_H
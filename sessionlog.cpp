@@ -0,0 +1,202 @@
+#include "sessionlog.h"
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+
+bool SessionRecorder::open(const QString &path)
+{
+    file.setFileName(path);
+    if (!file.open(QFile::WriteOnly | QFile::Append))
+    {
+        qWarning() << "Could not open session log" << path << file.errorString();
+        return false;
+    }
+    timer.start();
+    qInfo() << "recording session to" << path;
+    return true;
+}
+
+void SessionRecorder::record(const QString &type, QJsonObject fields)
+{
+    if (!file.isOpen())
+        return;
+    fields.insert("t", timer.elapsed());
+    fields.insert("type", type);
+    // Flushed immediately, such that the log survives a crash.
+    file.write(QJsonDocument(fields).toJson(QJsonDocument::Compact) + "\n");
+    file.flush();
+}
+
+
+SessionReplayer::SessionReplayer(QObject *parent) :
+    QObject(parent),
+    timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &SessionReplayer::dispatch);
+}
+
+bool SessionReplayer::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not read session log" << path;
+        return false;
+    }
+    events.clear();
+    int line_number = 0;
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine().trimmed();
+        line_number++;
+        if (line.isEmpty())
+            continue;
+        const QJsonObject data = QJsonDocument::fromJson(line).object();
+        if (!data.contains("t") || !data.contains("type"))
+        {
+            qWarning() << "Ignoring invalid line" << line_number << "of session log" << path;
+            continue;
+        }
+        events.append({data.value("t").toVariant().toLongLong(), data});
+    }
+    // Appended recordings restart at 0, keep them in sequence.
+    qint64 offset = 0;
+    for (int i=1; i<events.length(); i++)
+    {
+        if (events[i].time + offset < events[i-1].time)
+            offset = events[i-1].time - events[i].time;
+        events[i].time += offset;
+    }
+    qInfo() << "loaded" << events.length() << "events from session log" << path;
+    return true;
+}
+
+void SessionReplayer::start()
+{
+    if (idle && !idle())
+    {
+        QTimer::singleShot(50, this, &SessionReplayer::start);
+        return;
+    }
+    qInfo() << "replaying" << events.length() << "events at speed" << (speed > 0 ? QString::number(speed) : QString("max"));
+    next = 0;
+    clock.start();
+    dispatch();
+}
+
+void SessionReplayer::dispatch()
+{
+    while (next < events.length())
+    {
+        const Event &current = events[next];
+        if (speed > 0)
+        {
+            const qint64 due = qRound64((current.time - events.first().time) / speed);
+            if (due > clock.elapsed())
+            {
+                timer->start(int(due - clock.elapsed()));
+                return;
+            }
+        }
+        next++;
+        emit event(current.data);
+        if (speed <= 0)
+        {
+            // Return to the event loop between events, such that the
+            // application handles them like live input.
+            timer->start(0);
+            return;
+        }
+    }
+    waitAndFinish();
+}
+
+void SessionReplayer::waitAndFinish()
+{
+    if (idle && !idle())
+    {
+        QTimer::singleShot(50, this, &SessionReplayer::waitAndFinish);
+        return;
+    }
+    const QJsonObject result = report();
+    qInfo().noquote() << "replay finished:" << QJsonDocument(result).toJson(QJsonDocument::Compact);
+    if (!report_path.isEmpty())
+    {
+        QSaveFile file(report_path);
+        if (!file.open(QFile::WriteOnly)
+                || file.write(QJsonDocument(result).toJson()) < 0
+                || !file.commit())
+            qWarning() << "Could not write replay report" << report_path;
+    }
+    emit finished();
+}
+
+void SessionReplayer::wordsAdded(const int count)
+{
+    const qint64 now = clock.nsecsElapsed();
+    for (int i=0; i<count; i++)
+        waiting.append(now);
+    words += count;
+}
+
+void SessionReplayer::wordRejected(const bool added)
+{
+    rejected_words++;
+    if (added && !waiting.isEmpty())
+    {
+        waiting.removeLast();
+        words--;
+    }
+}
+
+void SessionReplayer::generationStarted()
+{
+    generations++;
+    in_flight += waiting;
+    waiting.clear();
+}
+
+void SessionReplayer::wordcloudShown()
+{
+    const qint64 now = clock.nsecsElapsed();
+    for (const qint64 added : in_flight)
+        latencies.append((now - added) / 1e6);
+    in_flight.clear();
+}
+
+QJsonObject SessionReplayer::report() const
+{
+    QVector<double> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    const auto percentile = [&sorted](const double p)
+    {
+        return sorted.isEmpty() ? 0. : sorted[qMin(sorted.length() - 1, int(p * sorted.length()))];
+    };
+    double sum = 0;
+    for (const double value : sorted)
+        sum += value;
+    return {
+        {"events", events.length()},
+        {"speed", speed},
+        {"duration_ms", clock.elapsed()},
+        {"words", words},
+        {"rejected_words", rejected_words},
+        // Words which never appeared in a shown word cloud.
+        {"unshown_words", waiting.length() + in_flight.length()},
+        {"update_requests", update_requests},
+        {"generations", generations},
+        // Update requests which were merged into another generation.
+        {"coalesced_updates", qMax(0, update_requests - generations)},
+        {"cancelled_generations", cancelled_generations},
+        {"latency_ms", QJsonObject{
+             {"count", sorted.length()},
+             {"mean", sorted.isEmpty() ? 0. : sum / sorted.length()},
+             {"p50", percentile(0.5)},
+             {"p90", percentile(0.9)},
+             {"p99", percentile(0.99)},
+             {"max", sorted.isEmpty() ? 0. : sorted.last()},
+         }},
+    };
+}
@@ -0,0 +1,115 @@
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QVector>
+#include <functional>
+
+
+/// Writes word submissions and operator actions of a live show to a session
+/// log, which can be replayed as load test by SessionReplayer. The log has
+/// one JSON object per line with time "t" in ms since the start of the
+/// recording and "type":
+/// - word: word and weight entered by the operator ("word", "weight")
+/// - words: batch of audience submissions ("words": [[word, weight], ...])
+/// - relayout
+/// - history: restore state of the undo history ("position"), with the
+///   resulting changes of the word list ("changes": [[word, weight], ...])
+/// - select, mark: video chosen or marked to be played next ("path")
+/// - stop, pause: stop video, toggle pause
+/// - seek: video position in ms ("position")
+class SessionRecorder
+{
+    QFile file;
+    QElapsedTimer timer;
+
+public:
+    /// Start recording to path (appending). Returns false on error.
+    bool open(const QString &path);
+    bool isOpen() const {return file.isOpen();}
+    /// Append event of type with the given fields, if recording.
+    void record(const QString &type, QJsonObject fields = {});
+};
+
+/// Replays a session log at a given speed and measures the latency from
+/// each accepted word until a word cloud containing it is shown. The events
+/// are applied by the receiver of the event signal, which reports progress
+/// of the word cloud generation back to the replayer.
+class SessionReplayer : public QObject
+{
+    Q_OBJECT
+
+    struct Event
+    {
+        qint64 time;
+        QJsonObject data;
+    };
+
+    QVector<Event> events;
+    /// Index of the next event.
+    int next = 0;
+    /// Speed factor, 0 for as fast as possible.
+    double speed = 1.;
+    QTimer *timer;
+    /// Time since the replay started.
+    QElapsedTimer clock;
+    /// Returns true when no word cloud generation is running or pending.
+    std::function<bool()> idle;
+    /// Write report to this file (in addition to the log).
+    QString report_path;
+
+    /// Times (ns on clock) at which words were added which are not handled
+    /// by a generation yet.
+    QVector<qint64> waiting;
+    /// Times at which words were added which are handled by the running
+    /// generation.
+    QVector<qint64> in_flight;
+    /// Latencies of shown words in ms.
+    QVector<double> latencies;
+    int words = 0;
+    int rejected_words = 0;
+    int update_requests = 0;
+    int generations = 0;
+    int cancelled_generations = 0;
+
+    /// Dispatch due events and schedule the next one.
+    void dispatch();
+    /// Wait for the word cloud to become idle, then report.
+    void waitAndFinish();
+    QJsonObject report() const;
+
+public:
+    SessionReplayer(QObject *parent = nullptr);
+    /// Load session log. Returns false if it could not be read.
+    bool load(const QString &path);
+    void setSpeed(const double factor) {speed = factor;}
+    void setIdleCheck(const std::function<bool()> &check) {idle = check;}
+    void setReportPath(const QString &path) {report_path = path;}
+    /// Start replay as soon as the word cloud is idle.
+    void start();
+
+    /// count accepted words were added to the word list.
+    void wordsAdded(const int count);
+    /// A word was rejected. If it was already counted by wordsAdded() (as
+    /// last word), the count is corrected.
+    void wordRejected(const bool added = false);
+    void updateRequested() {update_requests++;}
+    /// A generation started, which includes all words added so far.
+    void generationStarted();
+    /// The running generation was cancelled and is superseded by the next.
+    void generationCancelled() {cancelled_generations++;}
+    /// A word cloud was shown, which includes all words of the generation.
+    void wordcloudShown();
+
+signals:
+    /// Apply event (see SessionRecorder).
+    void event(const QJsonObject &data);
+    /// All events were applied and the report was written.
+    void finished();
+};
+
+#endif // SESSIONLOG_H
@@ -0,0 +1,61 @@
+#include "sharedimage.h"
+#include <QFileInfo>
+#include <QDebug>
+#include <cstring>
+
+bool SharedImageReader::open(const QString &path)
+{
+    if (data != nullptr && file.fileName() == path && QFileInfo(path).size() == mapped_size)
+        return true;
+    close();
+    file.setFileName(path);
+    if (!file.open(QFile::ReadOnly) || file.size() < header_size)
+    {
+        file.close();
+        return false;
+    }
+    mapped_size = file.size();
+    data = file.map(0, mapped_size);
+    if (data == nullptr)
+    {
+        qWarning() << "Could not map shared image:" << path;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SharedImageReader::close()
+{
+    if (data != nullptr)
+        file.unmap(data);
+    data = nullptr;
+    mapped_size = 0;
+    file.close();
+}
+
+bool SharedImageReader::header(Header &result) const
+{
+    if (data == nullptr)
+        return false;
+    std::memcpy(&result, data, sizeof(Header));
+    return std::memcmp(result.magic, "VSWC", 4) == 0
+            && result.version == 1
+            && result.stride >= 4*result.width
+            && header_size + 2*qint64(result.stride)*result.height <= mapped_size;
+}
+
+quint64 SharedImageReader::generation() const
+{
+    Header h;
+    return header(h) ? h.generation : 0;
+}
+
+QImage SharedImageReader::image() const
+{
+    Header h;
+    if (!header(h) || h.generation == 0)
+        return QImage();
+    const uchar *buffer = data + header_size + (h.generation % 2) * qint64(h.stride) * h.height;
+    return QImage(buffer, h.width, h.height, h.stride, QImage::Format_ARGB32_Premultiplied);
+}
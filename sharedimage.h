@@ -0,0 +1,51 @@
+#ifndef SHAREDIMAGE_H
+#define SHAREDIMAGE_H
+
+#include <QFile>
+#include <QImage>
+
+
+/// Read-only view of a raw word cloud image in a shared memory file, which is
+/// written by the external word cloud generator (see SharedImage in
+/// gen_wordcloud.py). The file starts with a 64 byte header, followed by two
+/// image buffers in premultiplied ARGB32 format. The image of generation n is
+/// stored in buffer n % 2.
+class SharedImageReader
+{
+    /// Header at the beginning of the shared memory file.
+    struct Header
+    {
+        char magic[4];
+        quint32 version;
+        quint32 width;
+        quint32 height;
+        quint32 stride;
+        quint32 reserved;
+        quint64 generation;
+    };
+    static const int header_size = 64;
+
+    /// Memory mapped file.
+    QFile file;
+    /// Mapped memory or nullptr.
+    uchar *data = nullptr;
+    /// Size of mapped memory.
+    qint64 mapped_size = 0;
+
+    /// Read and validate the header.
+    bool header(Header &result) const;
+
+public:
+    ~SharedImageReader() {close();}
+    /// Map the file at path. Does nothing if it is already mapped and its
+    /// size has not changed.
+    bool open(const QString &path);
+    void close();
+    /// Generation of the newest image, 0 if no image is available.
+    quint64 generation() const;
+    /// Newest image. The image uses the shared memory without copying, it
+    /// stays valid until the generator has written two more generations.
+    QImage image() const;
+};
+
+#endif // SHAREDIMAGE_H
@@ -0,0 +1,242 @@
+#include "trace.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QList>
+#include <QVector>
+#include <QThread>
+#include <QTimer>
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
+
+QAtomicInt Trace::active;
+
+namespace
+{
+
+struct Event
+{
+    /// Static string (not copied).
+    const char *name;
+    /// Start in ns since the trace clock started.
+    qint64 start;
+    /// Duration in ns, -1 for instant events.
+    qint64 duration;
+    /// Optional value shown as argument, -1 if none.
+    int value;
+};
+
+/// Ring buffer of one thread. Only the owning thread writes, head is
+/// published after the event is written.
+struct Buffer
+{
+    Event *events;
+    quint64 size;
+    /// Number of events recorded so far.
+    QAtomicInteger<quint64> head;
+    int tid;
+    QByteArray thread_name;
+};
+
+QMutex registry_mutex;
+/// Buffers of all threads which recorded events. Buffers are never freed,
+/// such that threads may exit while the trace is dumped.
+QList<Buffer*> buffers;
+int buffer_size = 65536;
+QString output_path = "/tmp/videoswitch-trace.json";
+thread_local Buffer *local_buffer = nullptr;
+#ifdef Q_OS_UNIX
+volatile sig_atomic_t pending_signal = 0;
+#endif
+
+QElapsedTimer &traceClock()
+{
+    static QElapsedTimer timer = []()
+    {
+        QElapsedTimer started;
+        started.start();
+        return started;
+    }();
+    return timer;
+}
+
+Buffer *threadBuffer()
+{
+    if (local_buffer != nullptr)
+        return local_buffer;
+    Buffer *buffer = new Buffer;
+    QMutexLocker locker(&registry_mutex);
+    buffer->size = buffer_size;
+    buffer->events = new Event[buffer->size];
+    buffer->head.storeRelease(0);
+    buffer->tid = buffers.length() + 1;
+    const QThread *thread = QThread::currentThread();
+    if (QCoreApplication::instance() != nullptr && thread == QCoreApplication::instance()->thread())
+        buffer->thread_name = "main";
+    else if (!thread->objectName().isEmpty())
+        buffer->thread_name = thread->objectName().toUtf8() + " " + QByteArray::number(buffer->tid);
+    else
+        buffer->thread_name = "thread " + QByteArray::number(buffer->tid);
+    buffers.append(buffer);
+    local_buffer = buffer;
+    return buffer;
+}
+
+void record(const Event &event)
+{
+    Buffer *buffer = threadBuffer();
+    const quint64 head = buffer->head.loadAcquire();
+    buffer->events[head % buffer->size] = event;
+    buffer->head.storeRelease(head + 1);
+}
+
+QByteArray microseconds(const qint64 ns)
+{
+    return QByteArray::number(ns / 1000., 'f', 3);
+}
+
+#ifdef Q_OS_UNIX
+void signalHandler(const int signal)
+{
+    pending_signal = signal;
+}
+#endif
+
+}
+
+void Trace::setEnabled(const bool enable)
+{
+    traceClock();
+    active.storeRelease(enable);
+    qInfo() << (enable ? "tracing enabled" : "tracing disabled");
+}
+
+void Trace::setBufferSize(const int events)
+{
+    QMutexLocker locker(&registry_mutex);
+    buffer_size = qMax(16, events);
+}
+
+void Trace::setOutputPath(const QString &path)
+{
+    QMutexLocker locker(&registry_mutex);
+    output_path = path;
+}
+
+qint64 Trace::now()
+{
+    return traceClock().nsecsElapsed();
+}
+
+void Trace::complete(const char *name, const qint64 start)
+{
+    if (enabled())
+        record({name, start, now() - start, -1});
+}
+
+void Trace::instant(const char *name, const int value)
+{
+    if (enabled())
+        record({name, now(), -1, value});
+}
+
+bool Trace::dump(const QString &path)
+{
+    QList<Buffer*> snapshot;
+    QString file_path = path;
+    {
+        QMutexLocker locker(&registry_mutex);
+        snapshot = buffers;
+        if (file_path.isEmpty())
+            file_path = output_path;
+    }
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"args\":{\"name\":\"videoswitch\"}}";
+    int count = 0;
+    for (const Buffer *buffer : snapshot)
+    {
+        const QByteArray tid = QByteArray::number(buffer->tid);
+        json += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid
+                + ",\"args\":{\"name\":\"" + buffer->thread_name + "\"}}";
+        const quint64 end = buffer->head.loadAcquire();
+        const quint64 begin = end > buffer->size ? end - buffer->size : 0;
+        QVector<Event> events;
+        events.reserve(end - begin);
+        for (quint64 i=begin; i<end; i++)
+            events.append(buffer->events[i % buffer->size]);
+        // The thread keeps recording, events in slots which it may have
+        // reused meanwhile are dropped.
+        const quint64 current = buffer->head.loadAcquire();
+        const quint64 valid = current >= buffer->size ? current - buffer->size + 1 : 0;
+        for (quint64 i=qMax(begin, valid); i<end; i++)
+        {
+            const Event &event = events[i - begin];
+            json += ",\n{\"name\":\"" + QByteArray(event.name) + "\",\"cat\":\"videoswitch\",\"pid\":" + pid + ",\"tid\":" + tid
+                    + ",\"ts\":" + microseconds(event.start);
+            if (event.duration >= 0)
+                json += ",\"ph\":\"X\",\"dur\":" + microseconds(event.duration);
+            else
+                json += ",\"ph\":\"i\",\"s\":\"t\"";
+            if (event.value >= 0)
+                json += ",\"args\":{\"value\":" + QByteArray::number(event.value) + "}";
+            json += "}";
+            count++;
+        }
+    }
+    json += "\n]}\n";
+    QSaveFile file(file_path);
+    if (!file.open(QFile::WriteOnly) || file.write(json) < 0 || !file.commit())
+    {
+        qWarning() << "Could not write trace to" << file_path;
+        return false;
+    }
+    qInfo() << "wrote" << count << "trace events to" << file_path;
+    return true;
+}
+
+void Trace::finish()
+{
+    bool recorded;
+    {
+        QMutexLocker locker(&registry_mutex);
+        recorded = !buffers.isEmpty();
+    }
+    if (recorded)
+        dump();
+}
+
+void Trace::installSignalHandlers(QObject *parent)
+{
+#ifdef Q_OS_UNIX
+    struct sigaction action = {};
+    action.sa_handler = signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &action, nullptr) != 0 || sigaction(SIGUSR2, &action, nullptr) != 0)
+    {
+        qWarning() << "Could not install signal handlers for tracing";
+        return;
+    }
+    // Only a flag is set in the signal handler, it is polled here.
+    QTimer *timer = new QTimer(parent);
+    timer->setInterval(200);
+    QObject::connect(timer, &QTimer::timeout, parent, []()
+    {
+        const int signal = pending_signal;
+        if (signal == 0)
+            return;
+        pending_signal = 0;
+        if (signal == SIGUSR1)
+            dump();
+        else if (signal == SIGUSR2)
+            setEnabled(!enabled());
+    });
+    timer->start();
+#else
+    Q_UNUSED(parent)
+#endif
+}
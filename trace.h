@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <QAtomicInt>
+
+class QObject;
+
+
+/// Timeline of events in Chrome trace format (open in chrome://tracing or
+/// https://ui.perfetto.dev). Each thread records into its own ring buffer
+/// without locks, the newest events are kept. When tracing is disabled,
+/// recording an event only costs an atomic load.
+class Trace
+{
+    static QAtomicInt active;
+
+public:
+    static bool enabled() {return active.loadAcquire();}
+    static void setEnabled(const bool enable);
+    /// Number of events kept per thread, only affects buffers of threads
+    /// which did not record yet.
+    static void setBufferSize(const int events);
+    /// File written by dump() without argument.
+    static void setOutputPath(const QString &path);
+    /// Time in ns since the trace clock started.
+    static qint64 now();
+    /// Record span from start (see now()) until now.
+    static void complete(const char *name, const qint64 start);
+    /// Record instant event, optionally with a value.
+    static void instant(const char *name, const int value = -1);
+    /// Write all buffered events as Chrome trace JSON. Returns false if the
+    /// file could not be written.
+    static bool dump(const QString &path = QString());
+    /// Dump if any events were recorded, called at exit.
+    static void finish();
+    /// Dump on SIGUSR1 and toggle tracing on SIGUSR2. The signals are
+    /// handled by a timer in the event loop of parent's thread.
+    static void installSignalHandlers(QObject *parent);
+};
+
+/// Record the lifetime of this object as span in the trace.
+class TraceSpan
+{
+    const char *name;
+    /// Start time, -1 if tracing was disabled.
+    qint64 start;
+
+public:
+    TraceSpan(const char *name) : name(name), start(Trace::enabled() ? Trace::now() : -1) {}
+    ~TraceSpan()
+    {
+        if (start >= 0)
+            Trace::complete(name, start);
+    }
+};
+
+#endif // TRACE_H
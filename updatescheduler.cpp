@@ -0,0 +1,69 @@
+#include "updatescheduler.h"
+#include "metrics.h"
+#include <QDebug>
+
+UpdateScheduler::UpdateScheduler(QObject *parent) :
+    QObject(parent),
+    debounce_timer(new QTimer(this))
+{
+    debounce_timer->setSingleShot(true);
+    connect(debounce_timer, &QTimer::timeout, this, &UpdateScheduler::schedule);
+}
+
+void UpdateScheduler::submit()
+{
+    if (pending_submissions++ == 0)
+        pending_timer.start();
+    last_submission_timer.start();
+    // Restart the debounce window.
+    debounce_timer->stop();
+    schedule();
+}
+
+void UpdateScheduler::schedule()
+{
+    if (running || pending_submissions == 0)
+        return;
+    if (debounce <= 0)
+    {
+        start();
+        return;
+    }
+    const qint64 quiet = last_submission_timer.elapsed();
+    const qint64 waiting = pending_timer.elapsed();
+    if (quiet >= debounce || (max_staleness > 0 && waiting >= max_staleness))
+    {
+        start();
+        return;
+    }
+    qint64 wait = debounce - quiet;
+    if (max_staleness > 0)
+        wait = qMin(wait, max_staleness - waiting);
+    debounce_timer->start(int(wait));
+}
+
+void UpdateScheduler::start()
+{
+    debounce_timer->stop();
+    running = true;
+    running_submissions = pending_submissions;
+    pending_submissions = 0;
+    running_timer = pending_timer;
+    generation_timer.start();
+    emit generate();
+}
+
+void UpdateScheduler::finished()
+{
+    if (!running)
+        return;
+    running = false;
+    Metrics &metrics = Metrics::instance();
+    metrics.observe("generation_ms", generation_timer.elapsed());
+    metrics.increment("generations_total");
+    metrics.increment("coalesced_submissions_total", running_submissions - 1);
+    qInfo().nospace() << "word cloud update: latency " << running_timer.elapsed()
+                      << " ms, generation " << generation_timer.elapsed()
+                      << " ms, " << running_submissions << " submission(s) coalesced";
+    schedule();
+}
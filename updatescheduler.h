@@ -0,0 +1,64 @@
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+
+/// Coalescing scheduler for word cloud updates. At most one generation is in
+/// flight and at most one is pending: all submissions which arrive while a
+/// generation is running are collapsed into the next generation.
+class UpdateScheduler : public QObject
+{
+    Q_OBJECT
+
+    /// Timer for the debounce window.
+    QTimer *debounce_timer;
+    /// Time since generation of the running update has started.
+    QElapsedTimer generation_timer;
+    /// Time since the first submission which is not yet handled.
+    QElapsedTimer pending_timer;
+    /// Time since the last submission.
+    QElapsedTimer last_submission_timer;
+    /// Time since the first submission handled by the running update.
+    QElapsedTimer running_timer;
+    /// A generation is currently in flight.
+    bool running = false;
+    /// Number of submissions waiting for the next generation.
+    int pending_submissions = 0;
+    /// Number of submissions handled by the running generation.
+    int running_submissions = 0;
+    /// Wait for this many ms without new submissions before starting a
+    /// generation. 0 means no debouncing.
+    int debounce = 0;
+    /// Start a generation at the latest this many ms after a submission,
+    /// even if the debounce window has not passed. 0 means no limit.
+    int max_staleness = 2000;
+
+    /// Start generation if possible or arm the debounce timer.
+    void schedule();
+    /// Start generation now.
+    void start();
+
+public:
+    UpdateScheduler(QObject *parent = nullptr);
+    void setDebounce(const int ms) {debounce = ms;}
+    void setMaxStaleness(const int ms) {max_staleness = ms;}
+    bool isRunning() const {return running;}
+    /// No generation is running or pending.
+    bool isIdle() const {return !running && pending_submissions == 0;}
+
+public slots:
+    /// Request an update. Does not start a generation if one is in flight.
+    void submit();
+    /// Must be called when the generation started by generate() is finished
+    /// (successfully or not).
+    void finished();
+
+signals:
+    /// Start a new generation. finished() must be called when it is done.
+    void generate();
+};
+
+#endif // UPDATESCHEDULER_H
@@ -0,0 +1,192 @@
+#include "videosurfaceitem.h"
+#include <QPainter>
+#include <QVideoSurfaceFormat>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "yuvconvert.h"
+#include "metrics.h"
+
+QList<QVideoFrame::PixelFormat> VideoSurfaceItem::Surface::supportedPixelFormats(QAbstractVideoBuffer::HandleType type) const
+{
+    if (type != QAbstractVideoBuffer::NoHandle)
+        return {};
+    // Preferred formats first: decoders usually produce YUV, which is
+    // cheaper to copy out of the decoder than RGB.
+    return {QVideoFrame::Format_YUV420P, QVideoFrame::Format_YV12, QVideoFrame::Format_NV12,
+            QVideoFrame::Format_RGB32, QVideoFrame::Format_ARGB32};
+}
+
+bool VideoSurfaceItem::Surface::start(const QVideoSurfaceFormat &format)
+{
+    if (!isFormatSupported(format))
+        return false;
+    item->setNativeSize(format.frameSize());
+    return QAbstractVideoSurface::start(format);
+}
+
+void VideoSurfaceItem::Surface::stop()
+{
+    item->setFrame(QVideoFrame());
+    QAbstractVideoSurface::stop();
+}
+
+bool VideoSurfaceItem::Surface::present(const QVideoFrame &frame)
+{
+    item->setFrame(frame);
+    return true;
+}
+
+
+VideoSurfaceItem::VideoSurfaceItem(QGraphicsItem *parent) :
+    QGraphicsObject(parent),
+    surface(new Surface(this))
+{
+}
+
+void VideoSurfaceItem::setSize(const QSizeF &new_size)
+{
+    prepareGeometryChange();
+    size = new_size;
+    update();
+}
+
+void VideoSurfaceItem::setNativeSize(const QSize &new_size)
+{
+    if (new_size == native_size)
+        return;
+    native_size = new_size;
+    update();
+    emit nativeSizeChanged(native_size);
+}
+
+void VideoSurfaceItem::setFrame(const QVideoFrame &new_frame)
+{
+    frame = new_frame;
+    frame_changed = true;
+    if (frame.isValid())
+        setNativeSize(frame.size());
+    else
+        scaled.clear();
+    update();
+}
+
+QRectF VideoSurfaceItem::boundingRect() const
+{
+    return QRectF(QPointF(), size);
+}
+
+QRectF VideoSurfaceItem::targetRect() const
+{
+    if (native_size.isEmpty())
+        return boundingRect();
+    const QSizeF scaled = QSizeF(native_size).scaled(size, Qt::KeepAspectRatio);
+    return QRectF(QPointF((size.width() - scaled.width()) / 2, (size.height() - scaled.height()) / 2), scaled);
+}
+
+bool VideoSurfaceItem::convert(const int alpha)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (!frame.map(QAbstractVideoBuffer::ReadOnly))
+    {
+        qWarning() << "Could not map video frame";
+        return false;
+    }
+    const int width = frame.width();
+    const int height = frame.height();
+    // Reuse the buffer unless its size changed or the painter still holds a
+    // reference to it.
+    if (buffer.size() != frame.size() || !buffer.isDetached())
+        buffer = QImage(frame.size(), QImage::Format_ARGB32_Premultiplied);
+    // Opaque pixels are valid in both formats, RGB32 is drawn faster.
+    buffer.reinterpretAsFormat(alpha == 255 ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied);
+
+    // Some backends only provide a single plane, then the chroma planes
+    // follow the luma plane.
+    const uchar *y_plane = frame.bits(0);
+    const int y_stride = frame.bytesPerLine(0);
+    const bool planes = frame.planeCount() > 1;
+    const uchar *c_plane = planes ? frame.bits(1) : y_plane + y_stride * height;
+    const int c_stride = planes ? frame.bytesPerLine(1) : (frame.pixelFormat() == QVideoFrame::Format_NV12 ? y_stride : y_stride / 2);
+
+    const YuvConvert::Kernels &kernels = YuvConvert::kernels();
+    if (frame.pixelFormat() == QVideoFrame::Format_NV12)
+    {
+        for (int row=0; row<height; row++)
+            kernels.nv12(y_plane + row * y_stride, c_plane + (row/2) * c_stride,
+                         reinterpret_cast<quint32*>(buffer.scanLine(row)), width, alpha);
+    }
+    else
+    {
+        const uchar *c2_plane = planes && frame.planeCount() > 2 ? frame.bits(2) : c_plane + c_stride * ((height + 1) / 2);
+        const int c2_stride = planes && frame.planeCount() > 2 ? frame.bytesPerLine(2) : c_stride;
+        const bool yv12 = frame.pixelFormat() == QVideoFrame::Format_YV12;
+        const uchar *u_plane = yv12 ? c2_plane : c_plane;
+        const uchar *v_plane = yv12 ? c_plane : c2_plane;
+        const int u_stride = yv12 ? c2_stride : c_stride;
+        const int v_stride = yv12 ? c_stride : c2_stride;
+        for (int row=0; row<height; row++)
+            kernels.planar(y_plane + row * y_stride, u_plane + (row/2) * u_stride, v_plane + (row/2) * v_stride,
+                           reinterpret_cast<quint32*>(buffer.scanLine(row)), width, alpha);
+    }
+    frame.unmap();
+    frame_changed = false;
+    buffer_alpha = alpha;
+    buffer_serial++;
+    Metrics::instance().observe("video_frame_convert_ms", timer.nsecsElapsed() / 1e6);
+    return true;
+}
+
+void VideoSurfaceItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(option)
+    const qreal opacity = painter->opacity();
+    const int alpha = qRound(255 * opacity);
+    if (!frame.isValid() || alpha <= 0)
+        return;
+
+    const QVideoFrame::PixelFormat format = frame.pixelFormat();
+    if (format == QVideoFrame::Format_RGB32 || format == QVideoFrame::Format_ARGB32)
+    {
+        // Already RGB, the painter applies the opacity.
+        if (!frame.map(QAbstractVideoBuffer::ReadOnly))
+            return;
+        const QImage image(frame.bits(), frame.width(), frame.height(), frame.bytesPerLine(),
+                           format == QVideoFrame::Format_RGB32 ? QImage::Format_RGB32 : QImage::Format_ARGB32);
+        painter->drawImage(targetRect(), image);
+        frame.unmap();
+        return;
+    }
+
+    if ((frame_changed || alpha != buffer_alpha) && !convert(alpha))
+        return;
+    // Opacity is already contained in the premultiplied buffer.
+    painter->setOpacity(1.);
+    const QTransform transform = painter->worldTransform();
+    const QRect device = transform.mapRect(targetRect()).toAlignedRect();
+    if (widget == nullptr || transform.type() > QTransform::TxScale || device.size() == buffer.size())
+        painter->drawImage(targetRect(), buffer);
+    else
+    {
+        // A new frame is usually painted once, scaling it while drawing is
+        // cheapest then. Only repainted frames are scaled into the cache.
+        Scaled &entry = scaled[widget];
+        if ((entry.serial != buffer_serial || entry.image.size() != device.size()) && entry.painted == buffer_serial)
+        {
+            const bool smooth = painter->testRenderHint(QPainter::SmoothPixmapTransform);
+            entry.image = buffer.scaled(device.size(), Qt::IgnoreAspectRatio, smooth ? Qt::SmoothTransformation : Qt::FastTransformation);
+            entry.serial = buffer_serial;
+        }
+        entry.painted = buffer_serial;
+        if (entry.serial == buffer_serial && entry.image.size() == device.size())
+        {
+            painter->save();
+            painter->resetTransform();
+            painter->drawImage(device.topLeft(), entry.image);
+            painter->restore();
+        }
+        else
+            painter->drawImage(targetRect(), buffer);
+    }
+    painter->setOpacity(opacity);
+}
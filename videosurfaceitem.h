@@ -0,0 +1,86 @@
+#ifndef VIDEOSURFACEITEM_H
+#define VIDEOSURFACEITEM_H
+
+#include <QGraphicsObject>
+#include <QAbstractVideoSurface>
+#include <QVideoFrame>
+#include <QImage>
+#include <QHash>
+
+
+/// Graphics item showing the frames of a QMediaPlayer, replacing
+/// QGraphicsVideoItem for software rendering. YUV frames are converted with
+/// SIMD kernels (see yuvconvert.h) when the item is painted, and the opacity
+/// of the item is applied in the same pass, such that drawing the frame
+/// over the word cloud is a plain premultiplied blit. The conversion buffer
+/// is reused across frames and shared by all views showing the item.
+class VideoSurfaceItem : public QGraphicsObject
+{
+    Q_OBJECT
+
+    /// Surface receiving the frames of the player.
+    class Surface : public QAbstractVideoSurface
+    {
+        VideoSurfaceItem *item;
+
+    public:
+        Surface(VideoSurfaceItem *item) : QAbstractVideoSurface(item), item(item) {}
+        QList<QVideoFrame::PixelFormat> supportedPixelFormats(QAbstractVideoBuffer::HandleType type = QAbstractVideoBuffer::NoHandle) const override;
+        bool start(const QVideoSurfaceFormat &format) override;
+        void stop() override;
+        bool present(const QVideoFrame &frame) override;
+    };
+
+    Surface *surface;
+    /// Size of the item, the video is scaled to fit keeping its aspect ratio.
+    QSizeF size = {320, 240};
+    /// Size of the video frames.
+    QSize native_size;
+    /// Latest frame, converted when it is painted.
+    QVideoFrame frame;
+    /// Frame was not converted yet.
+    bool frame_changed = false;
+    /// Converted frame (RGB32 if opaque, else premultiplied ARGB32).
+    QImage buffer;
+    /// Alpha with which buffer was converted.
+    int buffer_alpha = -1;
+    /// Incremented whenever buffer is converted.
+    quint64 buffer_serial = 0;
+
+    /// Buffer scaled to the device size of a view.
+    struct Scaled
+    {
+        /// Serial of the buffer which was painted last in the view.
+        quint64 painted = 0;
+        /// Serial of the buffer in image, 0 if none.
+        quint64 serial = 0;
+        QImage image;
+    };
+    /// Scaled buffers by viewport. A frame which is painted again in the
+    /// same view (paused video, changes below or above the video) is only
+    /// scaled once per view.
+    QHash<const QWidget*, Scaled> scaled;
+
+    /// Rectangle in item coordinates in which the video is drawn.
+    QRectF targetRect() const;
+    /// Convert frame into buffer with fused alpha. Returns false if the
+    /// frame could not be read.
+    bool convert(const int alpha);
+    void setFrame(const QVideoFrame &new_frame);
+    void setNativeSize(const QSize &new_size);
+
+public:
+    VideoSurfaceItem(QGraphicsItem *parent = nullptr);
+    /// Surface which is passed to QMediaPlayer::setVideoOutput().
+    QAbstractVideoSurface *videoSurface() const {return surface;}
+    void setSize(const QSizeF &new_size);
+    QSizeF nativeSize() const {return native_size;}
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+
+signals:
+    void nativeSizeChanged(const QSizeF &size);
+};
+
+#endif // VIDEOSURFACEITEM_H
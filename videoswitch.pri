@@ -0,0 +1,47 @@
+SOURCES += \
+    $$PWD/mainwindow.cpp \
+    $$PWD/wordcloudengine.cpp \
+    $$PWD/updatescheduler.cpp \
+    $$PWD/wordstore.cpp \
+    $$PWD/sharedimage.cpp \
+    $$PWD/playerpool.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/ingestserver.cpp \
+    $$PWD/wordfilter.cpp \
+    $$PWD/playlistmodel.cpp \
+    $$PWD/mediaprober.cpp \
+    $$PWD/maskrasterizer.cpp \
+    $$PWD/cloudcache.cpp \
+    $$PWD/yuvconvert.cpp \
+    $$PWD/videosurfaceitem.cpp \
+    $$PWD/crossfadeitem.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/sessionlog.cpp \
+    $$PWD/seekcontroller.cpp \
+    $$PWD/sequencerenderer.cpp \
+    $$PWD/outputview.cpp
+
+HEADERS += \
+    $$PWD/mainwindow.h \
+    $$PWD/wordcloudengine.h \
+    $$PWD/updatescheduler.h \
+    $$PWD/wordstore.h \
+    $$PWD/sharedimage.h \
+    $$PWD/playerpool.h \
+    $$PWD/metrics.h \
+    $$PWD/ingestserver.h \
+    $$PWD/wordfilter.h \
+    $$PWD/playlistmodel.h \
+    $$PWD/mediaprober.h \
+    $$PWD/maskrasterizer.h \
+    $$PWD/cloudcache.h \
+    $$PWD/yuvconvert.h \
+    $$PWD/videosurfaceitem.h \
+    $$PWD/crossfadeitem.h \
+    $$PWD/trace.h \
+    $$PWD/sessionlog.h \
+    $$PWD/seekcontroller.h \
+    $$PWD/sequencerenderer.h \
+    $$PWD/outputview.h
+
+INCLUDEPATH += $$PWD
@@ -1,4 +1,4 @@
-QT       += core gui multimedia multimediawidgets
+QT       += core gui multimedia multimediawidgets concurrent network svg
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,9 +8,10 @@ CONFIG += c++11
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-SOURCES += main.cpp mainwindow.cpp
+SOURCES += main.cpp
 
-HEADERS += mainwindow.h
+# Sources shared with the benchmark in benchmark/benchmark.pro.
+include(videoswitch.pri)
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,430 @@
+#include "wordcloudengine.h"
+
+#include <QFile>
+#include <QHash>
+#include <QPainter>
+#include <QFont>
+#include <QFontMetrics>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+
+void IntegralOccupancy::reset(const QImage &occupancy)
+{
+    width = occupancy.width();
+    height = occupancy.height();
+    table.fill(0, (width+1)*(height+1));
+    update(occupancy, 0, 0);
+}
+
+void IntegralOccupancy::update(const QImage &occupancy, const int x, const int y)
+{
+    const int stride = width + 1;
+    quint32 *const data = table.data();
+    for (int row=qMax(y, 0); row<height; row++)
+    {
+        const uchar *line = occupancy.constScanLine(row);
+        quint32 *above = data + row*stride;
+        quint32 *current = above + stride;
+        for (int col=qMax(x, 0); col<width; col++)
+            current[col+1] = (line[col] != 0) + above[col+1] + current[col] - above[col];
+    }
+}
+
+
+bool WordCloudEngine::loadMask(const QString &path)
+{
+    QImage image;
+    if (!image.load(path))
+    {
+        qWarning() << "Could not load mask image:" << path;
+        return false;
+    }
+    setMask(image);
+    return true;
+}
+
+void WordCloudEngine::setMask(const QImage &image)
+{
+    if (image.isNull())
+    {
+        mask = QImage();
+        return;
+    }
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    mask = QImage(rgb.size(), QImage::Format_Grayscale8);
+    for (int row=0; row<rgb.height(); row++)
+    {
+        const QRgb *in = reinterpret_cast<const QRgb*>(rgb.constScanLine(row));
+        uchar *out = mask.scanLine(row);
+        for (int col=0; col<rgb.width(); col++)
+            out[col] = (qRed(in[col]) == 0 || qGreen(in[col]) == 0 || qBlue(in[col]) == 0) ? 255 : 0;
+    }
+}
+
+WordCloudEngine WordCloudEngine::scaled(const qreal factor) const
+{
+    WordCloudEngine engine = *this;
+    const QSize scaled_size = outputSize() * factor;
+    if (!mask.isNull())
+        engine.mask = mask.scaled(scaled_size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    engine.size = scaled_size;
+    engine.max_font_size = qMax(1, qRound(max_font_size * factor));
+    engine.min_font_size = qMax(2, qRound(min_font_size * factor));
+    engine.margin = qMax(1, qRound(margin * factor));
+    return engine;
+}
+
+QRgb WordCloudEngine::colormap(const qreal x)
+{
+    const qreal r = 0.6 * (x < 0.75) * (0.75 - x);
+    const qreal g = 1. - 0.4 * (x > 0.5) * (x - 0.5)*(x - 0.5);
+    const qreal b = 0.5 * (x > 0.5) * (x - 0.5);
+    return qRgb(qBound(0, qRound(255*r), 255), qBound(0, qRound(255*g), 255), qBound(0, qRound(255*b), 255));
+}
+
+QImage WordCloudEngine::renderWord(const QString &word, const int font_size, const bool vertical) const
+{
+    QFont font(font_family);
+    font.setPixelSize(font_size);
+    // The tight bounding rect is given relative to the base line. Add one
+    // pixel on each side for antialiasing.
+    const QRect rect = QFontMetrics(font).tightBoundingRect(word).adjusted(-1, -1, 1, 1);
+    if (rect.isEmpty())
+        return QImage();
+    QImage glyph(vertical ? rect.size().transposed() : rect.size(), QImage::Format_ARGB32_Premultiplied);
+    glyph.fill(Qt::transparent);
+    QPainter painter(&glyph);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    if (vertical)
+    {
+        // Rotate by 90° counter-clockwise, text is read from bottom to top.
+        painter.translate(0, glyph.height());
+        painter.rotate(-90);
+    }
+    painter.drawText(-rect.left(), -rect.top(), word);
+    painter.end();
+    return glyph;
+}
+
+bool WordCloudEngine::findPosition(const IntegralOccupancy &integral, const int w, const int h, QRandomGenerator &rng, QPoint &position) const
+{
+    const int max_x = integral.getWidth() - w;
+    const int max_y = integral.getHeight() - h;
+    if (max_x < 0 || max_y < 0)
+        return false;
+    const qreal cx = rng.bounded(max_x + 1);
+    const qreal cy = rng.bounded(max_y + 1);
+    // Distance between two windings of the spiral. Gaps which are narrower
+    // than this are only found by chance, but the spiral stays short.
+    const qreal spacing = qMax(2, qMin(w, h)/4);
+    const qreal max_r = qSqrt(qMax(cx, max_x-cx)*qMax(cx, max_x-cx) + qMax(cy, max_y-cy)*qMax(cy, max_y-cy)) + spacing;
+    qreal theta = 0., r = 0.;
+    while (r <= max_r)
+    {
+        const int x = qRound(cx + r*qCos(theta));
+        const int y = qRound(cy + r*qSin(theta));
+        if (x >= 0 && y >= 0 && x <= max_x && y <= max_y && integral.sum(x, y, w, h) == 0)
+        {
+            position = QPoint(x, y);
+            return true;
+        }
+        theta += spacing / qMax(r, spacing);
+        r = spacing * theta / (2*M_PI);
+    }
+    return false;
+}
+
+QVector<WordFrequency> WordCloudEngine::prepare(QVector<WordFrequency> frequencies) const
+{
+    std::stable_sort(frequencies.begin(), frequencies.end(),
+                     [](const WordFrequency &a, const WordFrequency &b){return a.second > b.second;});
+    if (frequencies.length() > max_words)
+        frequencies.resize(max_words);
+    while (!frequencies.isEmpty() && frequencies.last().second <= 0)
+        frequencies.removeLast();
+    return frequencies;
+}
+
+QVector<int> WordCloudEngine::desiredSizes(const QVector<WordFrequency> &sorted) const
+{
+    QVector<int> sizes;
+    sizes.reserve(sorted.length());
+    qreal font_size = max_font_size;
+    qreal last_frequency = 1.;
+    for (const auto &item : sorted)
+    {
+        const qreal frequency = item.second / sorted.first().second;
+        if (relative_scaling > 0)
+            font_size *= relative_scaling * frequency / last_frequency + (1 - relative_scaling);
+        sizes.append(qRound(font_size));
+        last_frequency = frequency;
+    }
+    return sizes;
+}
+
+void WordCloudEngine::resetLayout(WordCloudLayout &layout) const
+{
+    layout.words.clear();
+    layout.saturated = false;
+    layout.interrupted = false;
+    layout.image = QImage(outputSize(), QImage::Format_ARGB32_Premultiplied);
+    layout.image.fill(Qt::black);
+    if (mask.isNull())
+    {
+        layout.occupancy = QImage(size, QImage::Format_Grayscale8);
+        layout.occupancy.fill(0);
+    }
+    else
+        layout.occupancy = mask.copy();
+    layout.integral.reset(layout.occupancy);
+    layout.rng.seed(random_seed);
+}
+
+bool WordCloudEngine::placeWord(WordCloudLayout &layout, const QString &word, WordPlacement &placement) const
+{
+    int font_size = placement.desired_size;
+    bool vertical = layout.rng.generateDouble() > prefer_horizontal;
+    bool tried_other_orientation = false;
+    QImage glyph;
+    QPoint position;
+    while (true)
+    {
+        if (font_size < min_font_size)
+            return false;
+        glyph = renderWord(word, font_size, vertical);
+        if (!glyph.isNull() && findPosition(layout.integral, glyph.width() + margin, glyph.height() + margin, layout.rng, position))
+            break;
+        // Try the other orientation before making the font smaller.
+        if (!tried_other_orientation && prefer_horizontal < 1)
+        {
+            vertical = !vertical;
+            tried_other_orientation = true;
+        }
+        else
+        {
+            font_size -= qMax(1, font_size/10);
+            vertical = false;
+        }
+    }
+    placement.font_size = font_size;
+    placement.vertical = vertical;
+    placement.position = position + QPoint(margin/2, margin/2);
+    placement.glyph = glyph;
+    if (placement.color == 0)
+        placement.color = colormap(layout.rng.generateDouble());
+
+    // Mark the pixels of the word as occupied.
+    const int x = placement.position.x();
+    const int y = placement.position.y();
+    for (int row=0; row<glyph.height(); row++)
+    {
+        const QRgb *in = reinterpret_cast<const QRgb*>(glyph.constScanLine(row));
+        uchar *out = layout.occupancy.scanLine(y + row) + x;
+        for (int col=0; col<glyph.width(); col++)
+            if (qAlpha(in[col]))
+                out[col] = 255;
+    }
+    layout.integral.update(layout.occupancy, x, y);
+
+    // Draw the word in its color.
+    QImage colored = glyph.copy();
+    {
+        QPainter painter(&colored);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        painter.fillRect(colored.rect(), QColor(placement.color));
+    }
+    QPainter painter(&layout.image);
+    painter.drawImage(placement.position, colored);
+    return true;
+}
+
+void WordCloudEngine::removeWord(WordCloudLayout &layout, const WordPlacement &placement) const
+{
+    // Words never share pixels, so exactly the pixels of the glyph can be
+    // cleared.
+    const int x = placement.position.x();
+    const int y = placement.position.y();
+    const QImage &glyph = placement.glyph;
+    for (int row=0; row<glyph.height(); row++)
+    {
+        const QRgb *in = reinterpret_cast<const QRgb*>(glyph.constScanLine(row));
+        uchar *occupied = layout.occupancy.scanLine(y + row) + x;
+        QRgb *pixel = reinterpret_cast<QRgb*>(layout.image.scanLine(y + row)) + x;
+        for (int col=0; col<glyph.width(); col++)
+        {
+            if (qAlpha(in[col]))
+            {
+                occupied[col] = 0;
+                pixel[col] = qRgb(0, 0, 0);
+            }
+        }
+    }
+    layout.integral.update(layout.occupancy, x, y);
+}
+
+QImage WordCloudEngine::generate(const QVector<WordFrequency> &frequencies) const
+{
+    WordCloudLayout layout;
+    layoutFull(frequencies, layout);
+    return layout.image;
+}
+
+void WordCloudEngine::layoutFull(const QVector<WordFrequency> &frequencies, WordCloudLayout &layout) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    resetLayout(layout);
+    const QVector<WordFrequency> sorted = prepare(frequencies);
+    const QVector<int> sizes = desiredSizes(sorted);
+    for (int i=0; i<sorted.length(); i++)
+    {
+        if (interrupted(timer))
+        {
+            layout.interrupted = true;
+            break;
+        }
+        WordPlacement placement;
+        placement.desired_size = sizes[i];
+        if (!placeWord(layout, sorted[i].first, placement))
+        {
+            // Word cloud is full.
+            layout.saturated = true;
+            break;
+        }
+        layout.words.insert(sorted[i].first, placement);
+    }
+}
+
+bool WordCloudEngine::layoutIncremental(const QVector<WordFrequency> &frequencies, WordCloudLayout &layout) const
+{
+    if (layout.image.isNull() || layout.image.size() != outputSize())
+    {
+        layoutFull(frequencies, layout);
+        return false;
+    }
+    // An interrupted layout is consistent, missing words are placed now.
+    layout.interrupted = false;
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<WordFrequency> sorted = prepare(frequencies);
+    const QVector<int> sizes = desiredSizes(sorted);
+    QHash<QString, int> targets;
+    targets.reserve(sorted.length());
+    for (int i=0; i<sorted.length(); i++)
+        targets.insert(sorted[i].first, sizes[i]);
+
+    // Remove words which are not shown anymore or of which the size has
+    // changed noticeably. Changed words keep their color.
+    QHash<QString, QRgb> colors;
+    int smallest_placed = INT_MAX;
+    for (auto it = layout.words.begin(); it != layout.words.end();)
+    {
+        const auto target = targets.constFind(it.key());
+        if (target == targets.constEnd() || qAbs(*target - it->desired_size) > qMax(2, it->desired_size/10))
+        {
+            removeWord(layout, *it);
+            if (target != targets.constEnd())
+                colors.insert(it.key(), it->color);
+            it = layout.words.erase(it);
+        }
+        else
+        {
+            smallest_placed = qMin(smallest_placed, it->desired_size);
+            ++it;
+        }
+    }
+
+    // Place new and changed words, largest first.
+    for (int i=0; i<sorted.length(); i++)
+    {
+        const QString &word = sorted[i].first;
+        if (layout.words.contains(word))
+            continue;
+        if (interrupted(timer))
+        {
+            layout.interrupted = true;
+            break;
+        }
+        WordPlacement placement;
+        placement.desired_size = sizes[i];
+        placement.color = colors.value(word, 0);
+        if (!placeWord(layout, word, placement))
+        {
+            if (sizes[i] >= smallest_placed)
+            {
+                // A less important word is shown while this one does not
+                // fit: the word cloud is saturated.
+                layoutFull(frequencies, layout);
+                return false;
+            }
+            layout.saturated = true;
+            break;
+        }
+        layout.words.insert(word, placement);
+    }
+    return true;
+}
+
+QVector<WordFrequency> WordCloudEngine::processText(const QString &text)
+{
+    static const QRegularExpression word_regex("\\w[\\w']+", QRegularExpression::UseUnicodePropertiesOption);
+    static const QRegularExpression number_regex("^\\d+$");
+    // Count words, grouped by lower case version.
+    QHash<QString, QHash<QString, int>> counts;
+    for (auto it = word_regex.globalMatch(text); it.hasNext();)
+    {
+        QString word = it.next().captured();
+        if (word.endsWith("'s", Qt::CaseInsensitive))
+            word.chop(2);
+        if (word.length() < 3 || number_regex.match(word).hasMatch())
+            continue;
+        counts[word.toLower()][word]++;
+    }
+    // Merge plurals into singular if the singular exists.
+    for (const QString &key : counts.keys())
+    {
+        if (!key.endsWith('s') || key.endsWith("ss"))
+            continue;
+        const QString singular = key.left(key.length() - 1);
+        if (!counts.contains(singular))
+            continue;
+        const QHash<QString, int> plural = counts.take(key);
+        QHash<QString, int> &target = counts[singular];
+        for (auto variant = plural.constBegin(); variant != plural.constEnd(); ++variant)
+            target[variant.key().left(variant.key().length() - 1)] += variant.value();
+    }
+    // Use most common case variant for each word.
+    QVector<WordFrequency> frequencies;
+    frequencies.reserve(counts.size());
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it)
+    {
+        QString best;
+        int best_count = 0, total = 0;
+        for (auto variant = it->constBegin(); variant != it->constEnd(); ++variant)
+        {
+            total += variant.value();
+            if (variant.value() > best_count)
+            {
+                best = variant.key();
+                best_count = variant.value();
+            }
+        }
+        frequencies.append({best, qreal(total)});
+    }
+    return frequencies;
+}
+
+QVector<WordFrequency> WordCloudEngine::readWordlist(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not read word list:" << path;
+        return {};
+    }
+    return processText(QString::fromUtf8(file.readAll()));
+}
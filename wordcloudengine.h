@@ -0,0 +1,177 @@
+#ifndef WORDCLOUDENGINE_H
+#define WORDCLOUDENGINE_H
+
+#include <QImage>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QRegularExpression>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+
+
+/// Word together with its weight (absolute or relative frequency).
+typedef QPair<QString, qreal> WordFrequency;
+
+/// Summed-area table (integral image) of an occupancy map. Checking whether
+/// a rectangle is free is O(1).
+class IntegralOccupancy
+{
+    /// Width of the occupancy map in pixels.
+    int width = 0;
+    /// Height of the occupancy map in pixels.
+    int height = 0;
+    /// (width+1)*(height+1) entries, first row and first column are zero.
+    QVector<quint32> table;
+
+public:
+    /// Rebuild the table from an 8 bit occupancy map (nonzero = occupied).
+    void reset(const QImage &occupancy);
+    /// Recompute the table for all pixels right of x and below y.
+    void update(const QImage &occupancy, const int x, const int y);
+    /// Number of occupied pixels in the given rectangle.
+    quint32 sum(const int x, const int y, const int w, const int h) const
+    {
+        const int stride = width + 1;
+        return table[(y+h)*stride + x+w] - table[y*stride + x+w]
+                - table[(y+h)*stride + x] + table[y*stride + x];
+    }
+    int getWidth() const {return width;}
+    int getHeight() const {return height;}
+};
+
+/// Word placed in a word cloud layout.
+struct WordPlacement
+{
+    /// Font size computed from the word frequency.
+    int desired_size = 0;
+    /// Font size actually used (smaller if the word did not fit).
+    int font_size = 0;
+    /// Word is rotated by 90°.
+    bool vertical = false;
+    /// Top left corner of glyph in the image.
+    QPoint position;
+    /// Rendered word, white on transparent background.
+    QImage glyph;
+    /// Color of the word, 0 if not chosen yet.
+    QRgb color = 0;
+};
+
+/// State of a word cloud, which allows updating it incrementally.
+struct WordCloudLayout
+{
+    /// Placed words.
+    QHash<QString, WordPlacement> words;
+    /// Rendered word cloud.
+    QImage image;
+    /// Occupancy map: mask and placed words.
+    QImage occupancy;
+    /// Integral image of occupancy.
+    IntegralOccupancy integral;
+    /// Random generator, continued in incremental updates.
+    QRandomGenerator rng;
+    /// Some words did not fit into the word cloud.
+    bool saturated = false;
+    /// Layout was stopped early (time budget or cancellation), some words
+    /// are missing.
+    bool interrupted = false;
+};
+
+/// Native word cloud layout engine. This does the same job as
+/// gen_wordcloud.py (which uses the python wordcloud package), but renders
+/// directly into a QImage without starting an external process.
+class WordCloudEngine
+{
+    /// Occupancy map of the mask: 255 where no words may be placed.
+    QImage mask;
+    /// Output size, used if no mask is set.
+    QSize size = {1920, 1080};
+    /// Font family used to render words.
+    QString font_family = "Titillium";
+    /// Font size of the most frequent word in pixels.
+    int max_font_size = 250;
+    /// Words are not drawn with smaller font size.
+    int min_font_size = 4;
+    /// Maximum number of words in the word cloud.
+    int max_words = 200;
+    /// Margin around each word in pixels.
+    int margin = 2;
+    /// Importance of relative word frequencies for font size (0 to 1).
+    qreal relative_scaling = 0.2;
+    /// Ratio of words which are placed horizontally.
+    qreal prefer_horizontal = 0.9;
+    /// Seed for the random generator, fixed for reproducible layouts.
+    quint32 random_seed = 42;
+    /// Stop placing words after this time in ms, 0 means no limit.
+    int time_budget = 0;
+    /// Stop placing words when this is set (if not null).
+    const QAtomicInt *cancel = nullptr;
+
+    /// Check time budget and cancellation before placing the next word.
+    bool interrupted(const QElapsedTimer &timer) const
+    {
+        return (time_budget > 0 && timer.elapsed() > time_budget) || (cancel != nullptr && cancel->loadAcquire());
+    }
+
+    /// Render word in given font size (and orientation) in white on
+    /// transparent background with tight bounding box.
+    QImage renderWord(const QString &word, const int font_size, const bool vertical) const;
+    /// Search a free position for a box of size w x h along an Archimedean
+    /// spiral starting at a random point. Returns false if no position
+    /// was found.
+    bool findPosition(const IntegralOccupancy &integral, const int w, const int h, QRandomGenerator &rng, QPoint &position) const;
+    /// Sort by weight, drop words which will not be shown.
+    QVector<WordFrequency> prepare(QVector<WordFrequency> frequencies) const;
+    /// Font sizes for sorted frequencies, following wordcloud's
+    /// relative_scaling.
+    QVector<int> desiredSizes(const QVector<WordFrequency> &sorted) const;
+    /// Clear image and occupancy map.
+    void resetLayout(WordCloudLayout &layout) const;
+    /// Place and draw word, starting at placement.desired_size and reducing
+    /// font size if necessary. Returns false if the word does not fit.
+    bool placeWord(WordCloudLayout &layout, const QString &word, WordPlacement &placement) const;
+    /// Erase word from image and occupancy map.
+    void removeWord(WordCloudLayout &layout, const WordPlacement &placement) const;
+
+public:
+    /// Load mask image from file. Pixels in which any color channel is 0
+    /// are excluded from the word cloud (same as in gen_wordcloud.py).
+    bool loadMask(const QString &path);
+    /// Set mask from image, see loadMask().
+    void setMask(const QImage &image);
+    /// Set output size, only used if no mask is set.
+    void setSize(const QSize &new_size) {size = new_size;}
+    void setFontFamily(const QString &family) {font_family = family;}
+    /// Size of generated images.
+    QSize outputSize() const {return mask.isNull() ? size : mask.size();}
+    void setTimeBudget(const int ms) {time_budget = ms;}
+    /// Abort layouts when flag is set. The flag must outlive the layout.
+    void setCancelFlag(const QAtomicInt *flag) {cancel = flag;}
+    /// Copy of this engine for layouts at reduced resolution (mask, size,
+    /// font sizes and margin multiplied by factor).
+    WordCloudEngine scaled(const qreal factor) const;
+
+    /// Lay out and render word cloud from word frequencies.
+    QImage generate(const QVector<WordFrequency> &frequencies) const;
+    /// Lay out all words from scratch.
+    void layoutFull(const QVector<WordFrequency> &frequencies, WordCloudLayout &layout) const;
+    /// Keep the existing layout and only place new words and words of which
+    /// the font size has changed. Falls back to layoutFull() if the layout
+    /// does not exist yet or if the word cloud is saturated. Returns false
+    /// if a full layout was done. Both layouts stop early if the time budget
+    /// is exceeded or the cancel flag is set.
+    bool layoutIncremental(const QVector<WordFrequency> &frequencies, WordCloudLayout &layout) const;
+
+    /// Colormap of different green shades, same as in gen_wordcloud.py.
+    static QRgb colormap(const qreal x);
+    /// Split text into words and count them, similar to wordcloud's
+    /// process_text: case variants and plurals are merged, numbers and words
+    /// shorter than 3 characters are ignored.
+    static QVector<WordFrequency> processText(const QString &text);
+    /// Read word list file and count words using processText().
+    static QVector<WordFrequency> readWordlist(const QString &path);
+};
+
+#endif // WORDCLOUDENGINE_H
@@ -0,0 +1,232 @@
+#include "wordfilter.h"
+#include <QFile>
+#include <QTextStream>
+#include <QHash>
+#include <QMap>
+#include <QQueue>
+#include <QDebug>
+
+int TermMatcher::child(const int node, const ushort c) const
+{
+    const Node &n = nodes[node];
+    int low = n.first_edge, high = n.first_edge + n.edge_count;
+    while (low < high)
+    {
+        const int mid = (low + high) / 2;
+        if (edges[mid].c < c)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < n.first_edge + n.edge_count && edges[low].c == c)
+        return edges[low].target;
+    return -1;
+}
+
+int TermMatcher::next(int node, const ushort c) const
+{
+    while (true)
+    {
+        const int target = child(node, c);
+        if (target >= 0)
+            return target;
+        if (node == 0)
+            return 0;
+        node = nodes[node].fail;
+    }
+}
+
+void TermMatcher::build(const QStringList &terms)
+{
+    // Build the trie with maps first, then flatten it into sorted edges.
+    QVector<QMap<ushort, int>> trie(1);
+    QVector<bool> term(1, false);
+    for (const QString &word : terms)
+    {
+        if (word.isEmpty())
+            continue;
+        int node = 0;
+        for (const QChar c : word)
+        {
+            auto it = trie[node].constFind(c.unicode());
+            if (it == trie[node].constEnd())
+            {
+                trie.append({});
+                term.append(false);
+                trie[node].insert(c.unicode(), trie.size() - 1);
+                node = trie.size() - 1;
+            }
+            else
+                node = it.value();
+        }
+        term[node] = true;
+    }
+
+    nodes = QVector<Node>(trie.size());
+    edges.clear();
+    edges.reserve(trie.size() - 1);
+    for (int i=0; i<trie.size(); i++)
+    {
+        nodes[i].first_edge = edges.size();
+        nodes[i].edge_count = trie[i].size();
+        nodes[i].term = term[i];
+        nodes[i].output = term[i];
+        for (auto it = trie[i].constBegin(); it != trie[i].constEnd(); ++it)
+            edges.append({it.key(), it.value()});
+    }
+
+    // Failure links in breadth-first order.
+    QQueue<int> queue;
+    queue.enqueue(0);
+    while (!queue.isEmpty())
+    {
+        const int node = queue.dequeue();
+        for (int e=nodes[node].first_edge; e<nodes[node].first_edge+nodes[node].edge_count; e++)
+        {
+            const int target = edges[e].target;
+            nodes[target].depth = nodes[node].depth + 1;
+            nodes[target].fail = node == 0 ? 0 : next(nodes[node].fail, edges[e].c);
+            nodes[target].output |= nodes[nodes[target].fail].output;
+            queue.enqueue(target);
+        }
+    }
+}
+
+bool TermMatcher::containsTerm(const QString &word) const
+{
+    if (isEmpty())
+        return false;
+    int node = 0;
+    for (const QChar c : word)
+    {
+        node = next(node, c.unicode());
+        if (nodes[node].output)
+            return true;
+    }
+    return false;
+}
+
+bool TermMatcher::isTerm(const QString &word) const
+{
+    if (isEmpty())
+        return false;
+    int node = 0;
+    for (const QChar c : word)
+    {
+        node = child(node, c.unicode());
+        if (node < 0)
+            return false;
+    }
+    return nodes[node].term;
+}
+
+
+bool WordFilter::scanWord(const QString &word)
+{
+    if (word.length() < 2)
+        return false;
+    const QChar first = word[0];
+    if (!first.isLetterOrNumber() && !first.isMark() && first != '_')
+        return false;
+    for (int i=1; i<word.length(); i++)
+    {
+        const QChar c = word[i];
+        if (c.unicode() < 128)
+        {
+            // Fast path for ASCII.
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '\''))
+                return false;
+        }
+        else if (!c.isLetterOrNumber() && !c.isMark())
+            return false;
+    }
+    return true;
+}
+
+QStringList WordFilter::readTerms(const QString &path, bool &ok)
+{
+    QStringList terms;
+    QFile file(path);
+    ok = file.open(QFile::ReadOnly | QFile::Text);
+    if (!ok)
+    {
+        qWarning() << "Could not read word filter list" << path;
+        return terms;
+    }
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    QString line;
+    while (stream.readLineInto(&line))
+    {
+        line = normalize(line);
+        if (!line.isEmpty() && !line.startsWith('#'))
+            terms.append(line);
+    }
+    return terms;
+}
+
+bool WordFilter::setPattern(const QString &regex)
+{
+    QRegularExpression expression("\\A(?:" + regex + ")\\z", QRegularExpression::UseUnicodePropertiesOption);
+    if (!expression.isValid())
+    {
+        qWarning() << "Invalid regular expression" << regex << expression.errorString();
+        return false;
+    }
+    expression.optimize();
+    pattern = expression;
+    use_pattern = true;
+    return true;
+}
+
+bool WordFilter::loadStopwords(const QString &path)
+{
+    bool ok;
+    const QStringList terms = readTerms(path, ok);
+    stopwords.build(terms);
+    qDebug() << "loaded" << terms.length() << "stopwords";
+    return ok;
+}
+
+bool WordFilter::loadBlocklist(const QString &path)
+{
+    bool ok;
+    const QStringList terms = readTerms(path, ok);
+    blocklist.build(terms);
+    qDebug() << "loaded" << terms.length() << "blocked terms";
+    return ok;
+}
+
+WordFilter::Verdict WordFilter::check(const QString &word) const
+{
+    if (word.isEmpty())
+        return Empty;
+    if (use_pattern ? !pattern.match(word).hasMatch() : !scanWord(word))
+        return InvalidCharacters;
+    if (stopwords.isEmpty() && blocklist.isEmpty())
+        return Accepted;
+    const QString folded = normalize(word);
+    if (blocklist.containsTerm(folded))
+        return Blocked;
+    if (stopwords.isTerm(folded))
+        return Stopword;
+    return Accepted;
+}
+
+QString WordFilter::reason(const Verdict verdict)
+{
+    switch (verdict)
+    {
+    case Accepted:
+        return "accepted";
+    case Empty:
+        return "empty word";
+    case InvalidCharacters:
+        return "invalid characters";
+    case Stopword:
+        return "stopword";
+    case Blocked:
+        return "blocked term";
+    }
+    return "unknown";
+}
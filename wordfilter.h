@@ -0,0 +1,99 @@
+#ifndef WORDFILTER_H
+#define WORDFILTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QRegularExpression>
+
+
+/// Aho-Corasick automaton over case folded terms. All terms are matched in
+/// a single pass over a word.
+class TermMatcher
+{
+    struct Node
+    {
+        /// Failure link: longest proper suffix which is a prefix of a term.
+        int fail = 0;
+        /// Length of the prefix represented by this node.
+        int depth = 0;
+        /// First transition in edges, transitions are sorted by character.
+        int first_edge = 0;
+        int edge_count = 0;
+        /// A term ends here.
+        bool term = false;
+        /// A term ends here or in a node reachable by failure links.
+        bool output = false;
+    };
+
+    struct Edge
+    {
+        ushort c;
+        int target;
+    };
+
+    QVector<Node> nodes;
+    QVector<Edge> edges;
+
+    /// Transition from node by c in the trie, -1 if there is none.
+    int child(const int node, const ushort c) const;
+    /// Transition of the automaton (following failure links).
+    int next(int node, const ushort c) const;
+
+public:
+    /// Build the automaton from (case folded) terms.
+    void build(const QStringList &terms);
+    bool isEmpty() const {return nodes.size() <= 1;}
+    /// Any term occurs in word.
+    bool containsTerm(const QString &word) const;
+    /// Word is a term.
+    bool isTerm(const QString &word) const;
+};
+
+/// Normalization and filtering of submitted words. Built once at startup,
+/// afterwards check() may be called from any thread.
+class WordFilter
+{
+public:
+    enum Verdict
+    {
+        Accepted,
+        Empty,
+        InvalidCharacters,
+        Stopword,
+        Blocked,
+    };
+
+private:
+    /// Custom pattern for valid words, if set.
+    QRegularExpression pattern;
+    bool use_pattern = false;
+    /// Words which are ignored.
+    TermMatcher stopwords;
+    /// Words containing any of these terms are rejected.
+    TermMatcher blocklist;
+
+    /// Same as matching "\w[\w']+", but without regular expression.
+    static bool scanWord(const QString &word);
+    /// Read one term per line, empty lines and lines starting with # are
+    /// ignored.
+    static QStringList readTerms(const QString &path, bool &ok);
+
+public:
+    /// Use regular expression for valid words instead of the default
+    /// "\w[\w']+". Returns false if pattern is invalid.
+    bool setPattern(const QString &regex);
+    /// Load stopwords (whole words) from file.
+    bool loadStopwords(const QString &path);
+    /// Load blocklist (matched anywhere in a word) from file.
+    bool loadBlocklist(const QString &path);
+
+    /// Normalized form used for matching: trimmed and case folded.
+    static QString normalize(const QString &word) {return word.trimmed().toCaseFolded();}
+    /// Check a word.
+    Verdict check(const QString &word) const;
+    /// Human readable reason of a verdict.
+    static QString reason(const Verdict verdict);
+};
+
+#endif // WORDFILTER_H
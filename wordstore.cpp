@@ -0,0 +1,204 @@
+#include "wordstore.h"
+#include <QSaveFile>
+#include <QTextStream>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+WordStore::WordStore(QObject *parent) :
+    QObject(parent),
+    sync_timer(new QTimer(this))
+{
+    sync_timer->setSingleShot(true);
+    sync_timer->setInterval(1000);
+    connect(sync_timer, &QTimer::timeout, this, &WordStore::sync);
+}
+
+WordStore::~WordStore()
+{
+    sync();
+}
+
+void WordStore::apply(const QString &word, const qreal weight)
+{
+    const QString key = word.toLower();
+    Entry &entry = entries[key];
+    if (entry.word.isEmpty())
+        entry.word = word;
+    entry.weight += weight;
+    // Negative weights undo additions.
+    if (entry.weight <= 1e-9)
+        entries.remove(key);
+}
+
+int WordStore::replay(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return 0;
+    int count = 0;
+    while (!file.atEnd())
+    {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.startsWith('#'))
+            continue;
+        const int tab = line.lastIndexOf('\t');
+        bool ok = false;
+        const qreal weight = tab > 0 ? line.midRef(tab + 1).toDouble(&ok) : 0;
+        if (!ok)
+        {
+            // Probably incomplete last line after a crash.
+            if (!line.isEmpty())
+                qWarning() << "Ignoring invalid line in" << path << ":" << line;
+            continue;
+        }
+        apply(line.left(tab), weight);
+        count++;
+    }
+    return count;
+}
+
+int WordStore::readGeneration(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return 0;
+    const QByteArray line = file.readLine().trimmed();
+    return line.startsWith("#generation ") ? line.mid(12).toInt() : 0;
+}
+
+bool WordStore::open(const QString &path)
+{
+    sync();
+    journal.close();
+    entries.clear();
+    snapshot_path = path + ".snapshot";
+    const int snapshot_generation = readGeneration(snapshot_path);
+    const int journal_generation = readGeneration(path + ".journal");
+    replay(snapshot_path);
+    // An older journal is already contained in the snapshot.
+    const bool outdated = journal_generation < snapshot_generation;
+    if (outdated)
+        qInfo() << "skipping word journal which is contained in the snapshot";
+    journal_entries = outdated ? 0 : replay(path + ".journal");
+    generation = qMax(snapshot_generation, journal_generation);
+    journal.setFileName(path + ".journal");
+    if (!journal.open(QFile::Append))
+    {
+        qWarning() << "Could not open word journal:" << journal.fileName();
+        return false;
+    }
+    if (outdated || journal.size() == 0)
+        resetJournal();
+    qDebug() << "loaded" << entries.size() << "words from" << path;
+    return true;
+}
+
+bool WordStore::importText(const QString &path)
+{
+    if (!QFile::exists(path))
+        return false;
+    for (const auto &item : WordCloudEngine::readWordlist(path))
+        apply(item.first, item.second);
+    qDebug() << "imported word list" << path;
+    return compact();
+}
+
+void WordStore::add(const QString &word, const qreal weight)
+{
+    apply(word, weight);
+    journal.write(word.toUtf8() + '\t' + QByteArray::number(weight) + '\n');
+    journal_entries++;
+    if (journal_entries >= compact_threshold)
+        compact();
+    else if (++unsynced >= sync_batch)
+        sync();
+    else if (!sync_timer->isActive())
+        sync_timer->start();
+}
+
+void WordStore::sync()
+{
+    sync_timer->stop();
+    if (!journal.isOpen() || unsynced == 0)
+        return;
+    journal.flush();
+#ifdef Q_OS_UNIX
+    ::fsync(journal.handle());
+#endif
+    unsynced = 0;
+}
+
+bool WordStore::compact()
+{
+    // If the journal is not truncated after the snapshot was written (e.g.
+    // after a crash), the new generation marks it as contained.
+    if (snapshot_path.isEmpty() || !writeEntries(snapshot_path, "#generation " + QByteArray::number(generation + 1) + "\n"))
+        return false;
+    generation++;
+    resetJournal();
+    return true;
+}
+
+void WordStore::resetJournal()
+{
+    if (journal.isOpen())
+    {
+        journal.resize(0);
+        journal.seek(0);
+        journal.write("#generation " + QByteArray::number(generation) + "\n");
+        journal.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(journal.handle());
+#endif
+    }
+    journal_entries = 0;
+    unsynced = 0;
+    sync_timer->stop();
+}
+
+QVector<WordFrequency> WordStore::frequencies() const
+{
+    QVector<WordFrequency> result;
+    result.reserve(entries.size());
+    for (const Entry &entry : entries)
+        result.append({entry.word, entry.weight});
+    return result;
+}
+
+quint64 WordStore::contentHash() const
+{
+    // Sum of mixed entry hashes, such that the hash does not depend on the
+    // (randomized) iteration order of the hash map.
+    quint64 hash = entries.size();
+    for (const Entry &entry : entries)
+    {
+        quint64 h = qHash(entry.word, 0x9e3779b9U);
+        h ^= quint64(qRound64(entry.weight * 1000)) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 31;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 29;
+        hash += h;
+    }
+    return hash;
+}
+
+bool WordStore::exportFrequencies(const QString &path) const
+{
+    return writeEntries(path, QByteArray());
+}
+
+bool WordStore::writeEntries(const QString &path, const QByteArray &header) const
+{
+    QSaveFile file(path);
+    if (!file.open(QFile::WriteOnly))
+    {
+        qWarning() << "Could not write word frequencies:" << path;
+        return false;
+    }
+    file.write(header);
+    for (const Entry &entry : entries)
+        file.write(entry.word.toUtf8() + '\t' + QByteArray::number(entry.weight) + '\n');
+    return file.commit();
+}
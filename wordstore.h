@@ -0,0 +1,88 @@
+#ifndef WORDSTORE_H
+#define WORDSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QFile>
+#include <QTimer>
+#include "wordcloudengine.h"
+
+
+/// Weighted word list. Words are kept in memory in a hash map (merging case
+/// variants) and persisted in an append-only journal, which is periodically
+/// compacted into a snapshot. Journal and snapshot contain lines of the form
+/// "word<TAB>weight". Weights in the journal are added to the snapshot.
+/// Both start with a line "#generation N". A snapshot of generation N
+/// contains all journals of lower generations, such that a journal which
+/// was not truncated because compaction was interrupted is not applied
+/// twice.
+class WordStore : public QObject
+{
+    Q_OBJECT
+
+    struct Entry
+    {
+        /// Word as it is shown in the word cloud.
+        QString word;
+        /// Total weight.
+        qreal weight = 0;
+    };
+
+    /// Words indexed by lower case version.
+    QHash<QString, Entry> entries;
+    /// Path of the snapshot file.
+    QString snapshot_path;
+    /// Journal file, opened for appending.
+    QFile journal;
+    /// Timer for syncing the journal to disk.
+    QTimer *sync_timer;
+    /// Number of journal entries which were not yet synced to disk.
+    int unsynced = 0;
+    /// Number of entries in the journal.
+    int journal_entries = 0;
+    /// Sync to disk at the latest after this number of entries.
+    int sync_batch = 64;
+    /// Compact journal into snapshot after this number of entries.
+    int compact_threshold = 4096;
+    /// Generation of the journal.
+    int generation = 0;
+
+    /// Add weight to word in memory.
+    void apply(const QString &word, const qreal weight);
+    /// Read file in journal / snapshot format and apply all entries.
+    int replay(const QString &path);
+    /// Write all words to path, preceded by header if it is not empty.
+    bool writeEntries(const QString &path, const QByteArray &header) const;
+    /// Truncate the journal and start it with the current generation.
+    void resetJournal();
+
+public:
+    WordStore(QObject *parent = nullptr);
+    ~WordStore();
+    /// Load snapshot and journal, which are found at path + ".snapshot" and
+    /// path + ".journal".
+    bool open(const QString &path);
+    /// Import a plain text word list (e.g. wordlist_init.txt).
+    bool importText(const QString &path);
+    /// Add weight to a word and write it to the journal. The word is
+    /// removed when its weight drops to zero.
+    void add(const QString &word, const qreal weight);
+    /// Write all words to the snapshot and clear the journal.
+    bool compact();
+    /// Current word frequencies for word cloud generation.
+    QVector<WordFrequency> frequencies() const;
+    /// Write current word frequencies to path (in snapshot format).
+    bool exportFrequencies(const QString &path) const;
+    /// Generation in the header of a journal or snapshot, 0 if it has none.
+    static int readGeneration(const QString &path);
+    /// Hash of all words and weights, independent of insertion order.
+    quint64 contentHash() const;
+    bool isEmpty() const {return entries.isEmpty();}
+    int size() const {return entries.size();}
+
+public slots:
+    /// Flush the journal and sync it to disk.
+    void sync();
+};
+
+#endif // WORDSTORE_H
@@ -0,0 +1,281 @@
+#include "yuvconvert.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define YUVCONVERT_X86
+#include <immintrin.h>
+#endif
+
+// Fixed point arithmetic in 16 bit, such that all implementations give
+// identical results:
+//   Y' = (Y-16)*1.164, R = Y' + 1.596*V', G = Y' - 0.392*U' - 0.813*V',
+//   B = Y' + 2.017*U' with U' = U-128, V' = V-128.
+// Luma and products keep 6 fractional bits. Coefficients are used in the
+// form of (x << 8) * c >> 16 (like _mm_mulhi_epi16).
+static const int coef_y = 19077;
+static const int coef_rv = 26148;
+static const int coef_gu = 6422;
+static const int coef_gv = 13320;
+// 2.017 = 2 + 0.017*64/64: the factor 2 is applied as shift.
+static const int coef_bu = 279;
+
+namespace
+{
+
+inline int saturate16(const int x)
+{
+    return x < -32768 ? -32768 : (x > 32767 ? 32767 : x);
+}
+
+inline int mulhi(const int a, const int b)
+{
+    return (a * b) >> 16;
+}
+
+inline quint32 clamp8(const int x)
+{
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+inline quint32 premultiply(const quint32 c, const int alpha)
+{
+    const quint32 t = c * alpha + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+inline quint32 convertPixel(const int y, const int u, const int v, const int alpha)
+{
+    const int luma = ((qMax(y - 16, 0) << 8) * coef_y) >> 16;
+    const int cu = u - 128;
+    const int cv = v - 128;
+    quint32 r = clamp8(saturate16(luma + mulhi(cv << 8, coef_rv)) >> 6);
+    quint32 g = clamp8(saturate16(saturate16(luma - mulhi(cu << 8, coef_gu)) - mulhi(cv << 8, coef_gv)) >> 6);
+    quint32 b = clamp8(saturate16(saturate16(luma + (cu << 7)) + mulhi(cu << 8, coef_bu)) >> 6);
+    if (alpha < 255)
+    {
+        r = premultiply(r, alpha);
+        g = premultiply(g, alpha);
+        b = premultiply(b, alpha);
+    }
+    return quint32(alpha) << 24 | r << 16 | g << 8 | b;
+}
+
+void planarRowScalar(const uchar *y, const uchar *u, const uchar *v, quint32 *out, const int width, const int alpha)
+{
+    for (int x=0; x<width; x++)
+        out[x] = convertPixel(y[x], u[x/2], v[x/2], alpha);
+}
+
+void nv12RowScalar(const uchar *y, const uchar *uv, quint32 *out, const int width, const int alpha)
+{
+    for (int x=0; x<width; x++)
+        out[x] = convertPixel(y[x], uv[x & ~1], uv[x | 1], alpha);
+}
+
+#ifdef YUVCONVERT_X86
+
+/// Convert 8 pixels in 16 bit lanes (u and v are centered and duplicated
+/// for each pixel) to r, g, b in 16 bit lanes (not clamped yet).
+inline void convert8Sse2(const __m128i y, const __m128i u, const __m128i v, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i luma = _mm_mulhi_epu16(_mm_slli_epi16(_mm_subs_epu16(y, _mm_set1_epi16(16)), 8), _mm_set1_epi16(coef_y));
+    const __m128i u8 = _mm_slli_epi16(u, 8);
+    const __m128i v8 = _mm_slli_epi16(v, 8);
+    r = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mulhi_epi16(v8, _mm_set1_epi16(coef_rv))), 6);
+    g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mulhi_epi16(u8, _mm_set1_epi16(coef_gu))),
+                                      _mm_mulhi_epi16(v8, _mm_set1_epi16(coef_gv))), 6);
+    b = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(luma, _mm_slli_epi16(u, 7)),
+                                      _mm_mulhi_epi16(u8, _mm_set1_epi16(coef_bu))), 6);
+}
+
+/// Premultiply 16 bytes with alpha.
+inline __m128i premultiplySse2(const __m128i c, const __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), alpha), half);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), alpha), half);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+/// Convert 16 pixels from luma and 8 centered chroma values in 16 bit lanes.
+inline void convert16Sse2(const uchar *y, const __m128i u, const __m128i v, quint32 *out, const int alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+    __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+    convert8Sse2(_mm_unpacklo_epi8(luma, zero), _mm_unpacklo_epi16(u, u), _mm_unpacklo_epi16(v, v), r_lo, g_lo, b_lo);
+    convert8Sse2(_mm_unpackhi_epi8(luma, zero), _mm_unpackhi_epi16(u, u), _mm_unpackhi_epi16(v, v), r_hi, g_hi, b_hi);
+    __m128i r = _mm_packus_epi16(r_lo, r_hi);
+    __m128i g = _mm_packus_epi16(g_lo, g_hi);
+    __m128i b = _mm_packus_epi16(b_lo, b_hi);
+    if (alpha < 255)
+    {
+        const __m128i a16 = _mm_set1_epi16(alpha);
+        r = premultiplySse2(r, a16);
+        g = premultiplySse2(g, a16);
+        b = premultiplySse2(b, a16);
+    }
+    const __m128i a = _mm_set1_epi8(char(alpha));
+    const __m128i bg_lo = _mm_unpacklo_epi8(b, g);
+    const __m128i bg_hi = _mm_unpackhi_epi8(b, g);
+    const __m128i ra_lo = _mm_unpacklo_epi8(r, a);
+    const __m128i ra_hi = _mm_unpackhi_epi8(r, a);
+    __m128i *dst = reinterpret_cast<__m128i*>(out);
+    _mm_storeu_si128(dst, _mm_unpacklo_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+void planarRowSse2(const uchar *y, const uchar *u, const uchar *v, quint32 *out, const int width, const int alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i center = _mm_set1_epi16(128);
+    int x = 0;
+    for (; x+16<=width; x+=16)
+    {
+        const __m128i cu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x/2)), zero), center);
+        const __m128i cv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x/2)), zero), center);
+        convert16Sse2(y + x, cu, cv, out + x, alpha);
+    }
+    planarRowScalar(y + x, u + x/2, v + x/2, out + x, width - x, alpha);
+}
+
+void nv12RowSse2(const uchar *y, const uchar *uv, quint32 *out, const int width, const int alpha)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    const __m128i center = _mm_set1_epi16(128);
+    int x = 0;
+    for (; x+16<=width; x+=16)
+    {
+        const __m128i chroma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+        const __m128i cu = _mm_sub_epi16(_mm_and_si128(chroma, mask), center);
+        const __m128i cv = _mm_sub_epi16(_mm_srli_epi16(chroma, 8), center);
+        convert16Sse2(y + x, cu, cv, out + x, alpha);
+    }
+    nv12RowScalar(y + x, uv + x, out + x, width - x, alpha);
+}
+
+// AVX2: 32 pixels per iteration. Most instructions work within 128 bit
+// lanes, the chroma and output are permuted accordingly.
+
+__attribute__((target("avx2")))
+inline void convert16Avx2(const __m256i y, const __m256i u, const __m256i v, __m256i &r, __m256i &g, __m256i &b)
+{
+    const __m256i luma = _mm256_mulhi_epu16(_mm256_slli_epi16(_mm256_subs_epu16(y, _mm256_set1_epi16(16)), 8), _mm256_set1_epi16(coef_y));
+    const __m256i u8 = _mm256_slli_epi16(u, 8);
+    const __m256i v8 = _mm256_slli_epi16(v, 8);
+    r = _mm256_srai_epi16(_mm256_adds_epi16(luma, _mm256_mulhi_epi16(v8, _mm256_set1_epi16(coef_rv))), 6);
+    g = _mm256_srai_epi16(_mm256_subs_epi16(_mm256_subs_epi16(luma, _mm256_mulhi_epi16(u8, _mm256_set1_epi16(coef_gu))),
+                                            _mm256_mulhi_epi16(v8, _mm256_set1_epi16(coef_gv))), 6);
+    b = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(luma, _mm256_slli_epi16(u, 7)),
+                                            _mm256_mulhi_epi16(u8, _mm256_set1_epi16(coef_bu))), 6);
+}
+
+__attribute__((target("avx2")))
+inline __m256i premultiplyAvx2(const __m256i c, const __m256i alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(c, zero), alpha), half);
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(c, zero), alpha), half);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+    return _mm256_packus_epi16(lo, hi);
+}
+
+/// Convert 32 pixels from luma and 16 centered chroma values in 16 bit
+/// lanes (in pixel order).
+__attribute__((target("avx2")))
+inline void convert32Avx2(const uchar *y, __m256i u, __m256i v, quint32 *out, const int alpha)
+{
+    // Make unpacklo/unpackhi produce chroma for pixels 0-15 and 16-31.
+    u = _mm256_permute4x64_epi64(u, 0xD8);
+    v = _mm256_permute4x64_epi64(v, 0xD8);
+    const __m256i y_lo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)));
+    const __m256i y_hi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + 16)));
+    __m256i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+    convert16Avx2(y_lo, _mm256_unpacklo_epi16(u, u), _mm256_unpacklo_epi16(v, v), r_lo, g_lo, b_lo);
+    convert16Avx2(y_hi, _mm256_unpackhi_epi16(u, u), _mm256_unpackhi_epi16(v, v), r_hi, g_hi, b_hi);
+    // Lanes now contain pixels [0-7, 16-23 | 8-15, 24-31].
+    __m256i r = _mm256_packus_epi16(r_lo, r_hi);
+    __m256i g = _mm256_packus_epi16(g_lo, g_hi);
+    __m256i b = _mm256_packus_epi16(b_lo, b_hi);
+    if (alpha < 255)
+    {
+        const __m256i a16 = _mm256_set1_epi16(alpha);
+        r = premultiplyAvx2(r, a16);
+        g = premultiplyAvx2(g, a16);
+        b = premultiplyAvx2(b, a16);
+    }
+    const __m256i a = _mm256_set1_epi8(char(alpha));
+    // [0-7 | 8-15] and [16-23 | 24-31]
+    const __m256i bg_lo = _mm256_unpacklo_epi8(b, g);
+    const __m256i bg_hi = _mm256_unpackhi_epi8(b, g);
+    const __m256i ra_lo = _mm256_unpacklo_epi8(r, a);
+    const __m256i ra_hi = _mm256_unpackhi_epi8(r, a);
+    // [0-3 | 8-11], [4-7 | 12-15], ...
+    const __m256i p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);
+    const __m256i p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);
+    const __m256i p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);
+    const __m256i p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);
+    __m256i *dst = reinterpret_cast<__m256i*>(out);
+    _mm256_storeu_si256(dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+__attribute__((target("avx2")))
+void planarRowAvx2(const uchar *y, const uchar *u, const uchar *v, quint32 *out, const int width, const int alpha)
+{
+    const __m256i center = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x+32<=width; x+=32)
+    {
+        const __m256i cu = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x/2))), center);
+        const __m256i cv = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x/2))), center);
+        convert32Avx2(y + x, cu, cv, out + x, alpha);
+    }
+    planarRowSse2(y + x, u + x/2, v + x/2, out + x, width - x, alpha);
+}
+
+__attribute__((target("avx2")))
+void nv12RowAvx2(const uchar *y, const uchar *uv, quint32 *out, const int width, const int alpha)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    const __m256i center = _mm256_set1_epi16(128);
+    int x = 0;
+    for (; x+32<=width; x+=32)
+    {
+        const __m256i chroma = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + x));
+        const __m256i cu = _mm256_sub_epi16(_mm256_and_si256(chroma, mask), center);
+        const __m256i cv = _mm256_sub_epi16(_mm256_srli_epi16(chroma, 8), center);
+        convert32Avx2(y + x, cu, cv, out + x, alpha);
+    }
+    nv12RowSse2(y + x, uv + x, out + x, width - x, alpha);
+}
+
+#endif // YUVCONVERT_X86
+
+}
+
+const YuvConvert::Kernels &YuvConvert::scalarKernels()
+{
+    static const Kernels kernels = {planarRowScalar, nv12RowScalar, "scalar"};
+    return kernels;
+}
+
+const YuvConvert::Kernels &YuvConvert::kernels()
+{
+#ifdef YUVCONVERT_X86
+    static const Kernels sse2 = {planarRowSse2, nv12RowSse2, "sse2"};
+    static const Kernels avx2 = {planarRowAvx2, nv12RowAvx2, "avx2"};
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2 ? avx2 : sse2;
+#else
+    return scalarKernels();
+#endif
+}
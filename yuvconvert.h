@@ -0,0 +1,31 @@
+#ifndef YUVCONVERT_H
+#define YUVCONVERT_H
+
+#include <QtGlobal>
+
+
+/// Conversion of YUV video frames (BT.601, limited range) to 32 bit
+/// (A)RGB rows in QImage byte order. The opacity is fused into the same
+/// pass: with alpha < 255 the output is premultiplied ARGB.
+namespace YuvConvert
+{
+    /// Convert one row of planar YUV 4:2:0 (u and v have half width).
+    typedef void (*PlanarRow)(const uchar *y, const uchar *u, const uchar *v, quint32 *out, const int width, const int alpha);
+    /// Convert one row of NV12 (interleaved uv with half width).
+    typedef void (*Nv12Row)(const uchar *y, const uchar *uv, quint32 *out, const int width, const int alpha);
+
+    struct Kernels
+    {
+        PlanarRow planar;
+        Nv12Row nv12;
+        /// Instruction set: "avx2", "sse2" or "scalar".
+        const char *name;
+    };
+
+    /// Fastest kernels supported by the CPU, selected once at runtime.
+    const Kernels &kernels();
+    /// Portable kernels (reference for the SIMD versions).
+    const Kernels &scalarKernels();
+}
+
+#endif // YUVCONVERT_H